@@ -0,0 +1,432 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_BENCH_BENCH_H_
+#define FUNC_BENCH_BENCH_H_
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "test/counters.h"
+
+namespace fn {
+namespace bench {
+
+// A light-weight benchmark harness, in the spirit of test/test.h. Each
+// benchmark is a function called repeatedly after a few warmup calls:
+//
+//   fn::bench::Suite suite(argc, argv);
+//   suite.run("vector/1000/sum/fn", 1000, [&] { return _(&v).sum(); });
+//   return suite.finish();
+//
+// The result of the function is kept alive, so that the compiler cannot
+// optimize the benchmarked code away.
+//
+// The results can be saved as a baseline, and later runs compared against it:
+// a benchmark regresses when its median is slower than the baseline by more
+// than the noise band and a Mann-Whitney U test on the timings agrees, or when
+// it allocates or copies more. The suite then exits with 1.
+
+// Forces the compiler to compute v.
+template <typename T>
+inline void keep(const T& v) {
+#if defined(__GNUC__)
+  asm volatile("" : : "g"(&v) : "memory");
+#else
+  static volatile const void* sink;
+  sink = &v;
+#endif
+}
+
+// Allocations and copies are counted like in the tests, with the allocation
+// functions of test/allocations.cc.
+using fn::test::Counted;
+using fn::test::allocation_count;
+
+// The timings of one benchmark, in nanoseconds per call, and the allocations
+// and element copies of one call. Copies are -1 unless counted.
+struct Result {
+  std::string name;
+  size_t elements;
+  std::vector<double> times;
+  double median;
+  double p99;
+  double allocations;
+  double copies;
+
+  double per_element() const { return elements ? median / elements : median; }
+};
+
+// The probability of timings b being at least as large as timings a if they
+// came from the same distribution, using a one-sided Mann-Whitney U test with
+// the normal approximation.
+inline double mann_whitney(const std::vector<double>& a,
+                           const std::vector<double>& b) {
+  std::vector<std::pair<double, bool>> all;
+  for (auto t : a) {
+    all.push_back(std::make_pair(t, false));
+  }
+
+  for (auto t : b) {
+    all.push_back(std::make_pair(t, true));
+  }
+
+  std::sort(all.begin(), all.end());
+
+  // Tied timings get the average of their ranks.
+  const double n = all.size();
+  double rank_sum = 0;
+  double ties = 0;
+  for (size_t i = 0; i < all.size();) {
+    auto j = i;
+    while (j < all.size() && all[j].first == all[i].first) {
+      j++;
+    }
+
+    const double rank = (i + 1 + j) / 2.0;
+    for (auto k = i; k < j; k++) {
+      rank_sum += all[k].second ? rank : 0;
+    }
+
+    const double t = j - i;
+    ties += t * t * t - t;
+    i = j;
+  }
+
+  const double na = a.size();
+  const double nb = b.size();
+  const auto u = rank_sum - nb * (nb + 1) / 2;
+  const auto sigma =
+      std::sqrt(na * nb / 12 * ((n + 1) - ties / (n * (n - 1))));
+  if (sigma == 0) {
+    return 1;
+  }
+
+  const auto z = (u - na * nb / 2 - 0.5) / sigma;
+  return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+class Suite {
+ public:
+  // Flags:
+  //   --json             Prints the results as JSON, instead of a table.
+  //   --filter=<text>    Only runs the benchmarks whose name contains text.
+  //   --repetitions=<n>  Number of timed calls per benchmark (default 31).
+  //   --warmup=<n>       Number of calls before timing (default 3).
+  //   --save=<path>      Saves the results as a baseline.
+  //   --baseline=<path>  Compares the results against a saved baseline.
+  //   --noise=<ratio>    Slowdowns below this ratio of the baseline median are
+  //                      noise (default 0.1).
+  //   --alpha=<p>        The significance level of regressions (default 0.01).
+  Suite(int argc, char** argv)
+      : json_(false),
+        repetitions_(31),
+        warmup_(3),
+        noise_(0.1),
+        alpha_(0.01),
+        counting_copies_(false) {
+    for (int i = 1; i < argc; i++) {
+      const std::string arg = argv[i];
+      std::string value;
+      if (arg == "--json") {
+        json_ = true;
+      } else if (flag(arg, "--filter=", &filter_) ||
+                 flag(arg, "--save=", &save_) ||
+                 flag(arg, "--baseline=", &baseline_)) {
+        continue;
+      } else if (flag(arg, "--repetitions=", &value)) {
+        repetitions_ = std::max(1, atoi(value.c_str()));
+      } else if (flag(arg, "--warmup=", &value)) {
+        warmup_ = std::max(0, atoi(value.c_str()));
+      } else if (flag(arg, "--noise=", &value)) {
+        noise_ = atof(value.c_str());
+      } else if (flag(arg, "--alpha=", &value)) {
+        alpha_ = atof(value.c_str());
+      } else {
+        std::cerr << "Unknown flag: " << arg << std::endl;
+        exit(2);
+      }
+    }
+  }
+
+  // Times f, which processes the given number of elements, and counts the
+  // allocations of one call.
+  template <typename F>
+  void run(const std::string& name, size_t elements, F f) {
+    if (name.find(filter_) == std::string::npos) {
+      return;
+    }
+
+    if (counting_copies_) {
+      count(name, f);
+      return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    using Nanos = std::chrono::duration<double, std::nano>;
+
+    for (int i = 0; i < warmup_; i++) {
+      keep(f());
+    }
+
+    std::vector<double> times;
+    for (int i = 0; i < repetitions_; i++) {
+      const auto start = Clock::now();
+      keep(f());
+      times.push_back(Nanos(Clock::now() - start).count());
+    }
+
+    size_t allocations = allocation_count();
+    keep(f());
+    allocations = allocation_count() - allocations;
+
+    auto sorted = times;
+    std::sort(sorted.begin(), sorted.end());
+    const auto p99 = (sorted.size() * 99 + 99) / 100 - 1;
+    results_.push_back(Result{name, elements, times, sorted[sorted.size() / 2],
+                              sorted[p99], double(allocations), -1});
+  }
+
+  // While enabled, run() does not time the benchmarks: it counts the copies of
+  // Counted elements made by one call, and adds them to the earlier result of
+  // the same name.
+  void count_copies(bool enabled) { counting_copies_ = enabled; }
+
+  // Prints the results, as a table or as JSON, once the copies are counted too.
+  // Then saves the baseline, and compares the results to the baseline. Returns
+  // 1 if any benchmark regressed.
+  int finish() const {
+    if (json_) {
+      std::cout << to_json(false);
+    } else {
+      print();
+    }
+
+    if (!save_.empty()) {
+      std::ofstream out(save_);
+      out << to_json(true);
+      out.close();
+      if (!out) {
+        std::cerr << "Cannot save the baseline " << save_ << std::endl;
+        return 2;
+      }
+    }
+
+    return baseline_.empty() ? 0 : compare();
+  }
+
+ private:
+  static bool flag(const std::string& arg, const std::string& name,
+                   std::string* value) {
+    if (arg.compare(0, name.size(), name) != 0) {
+      return false;
+    }
+
+    *value = arg.substr(name.size());
+    return true;
+  }
+
+  template <typename F>
+  void count(const std::string& name, F f) {
+    for (auto& r : results_) {
+      if (r.name == name) {
+        const auto copies = Counted::copies();
+        keep(f());
+        r.copies = Counted::copies() - copies;
+      }
+    }
+  }
+
+  // Formats a count, which is -1 when it was not counted.
+  static std::string count_text(double count) {
+    return count < 0 ? "-" : std::to_string(static_cast<long>(count));
+  }
+
+  void print() const {
+    printf("%-36s %12s %12s %11s %7s %7s\n", "benchmark", "median (ns)",
+           "p99 (ns)", "ns/element", "allocs", "copies");
+    for (const auto& r : results_) {
+      printf("%-36s %12.0f %12.0f %11.3f %7.0f %7s\n", r.name.c_str(), r.median,
+             r.p99, r.per_element(), r.allocations,
+             count_text(r.copies).c_str());
+    }
+  }
+
+  // Baselines also hold the timings of each repetition.
+  std::string to_json(bool times) const {
+    std::ostringstream json;
+    json << "{\"benchmarks\": [";
+    for (size_t i = 0; i < results_.size(); i++) {
+      const auto& r = results_[i];
+      char line[512];
+      snprintf(line, sizeof(line),
+               "%s\n  {\"name\": \"%s\", \"elements\": %zu, "
+               "\"repetitions\": %zu, \"median_ns\": %.1f, \"p99_ns\": %.1f, "
+               "\"ns_per_element\": %.3f, \"allocations\": %.0f, "
+               "\"copies\": %.0f",
+               i ? "," : "", r.name.c_str(), r.elements, r.times.size(),
+               r.median, r.p99, r.per_element(), r.allocations, r.copies);
+      json << line;
+      if (times) {
+        json << ", \"times_ns\": [";
+        for (size_t j = 0; j < r.times.size(); j++) {
+          json << (j ? ", " : "") << r.times[j];
+        }
+
+        json << "]";
+      }
+
+      json << "}";
+    }
+
+    json << "\n]}\n";
+    return json.str();
+  }
+
+  // Reads the results saved by to_json(true). Only the fields needed for the
+  // comparison are read.
+  static std::map<std::string, Result> read_baseline(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+      bad_baseline(path);
+    }
+
+    std::stringstream content;
+    content << in.rdbuf();
+    const auto json = content.str();
+
+    std::map<std::string, Result> results;
+    const std::string kName = "\"name\": \"";
+    const std::string kTimes = "\"times_ns\": [";
+    for (auto pos = json.find(kName); pos != std::string::npos;
+         pos = json.find(kName, pos)) {
+      pos += kName.size();
+      const auto name_end = json.find('"', pos);
+      const auto times = json.find(kTimes, pos);
+      if (name_end == std::string::npos || times == std::string::npos ||
+          times > json.find(kName, pos)) {
+        bad_baseline(path);
+      }
+
+      Result r;
+      r.name = json.substr(pos, name_end - pos);
+      r.allocations = number(json, pos, "\"allocations\": ", path);
+      r.copies = number(json, pos, "\"copies\": ", path);
+
+      const char* p = json.c_str() + times + kTimes.size();
+      for (char* end; *p != ']'; p = end + (*end == ',')) {
+        r.times.push_back(strtod(p, &end));
+        if (end == p) {
+          bad_baseline(path);
+        }
+      }
+
+      auto sorted = r.times;
+      std::sort(sorted.begin(), sorted.end());
+      r.median = sorted.empty() ? 0 : sorted[sorted.size() / 2];
+      results[r.name] = r;
+    }
+
+    return results;
+  }
+
+  static double number(const std::string& json, size_t pos,
+                       const std::string& key, const std::string& path) {
+    const auto found = json.find(key, pos);
+    if (found == std::string::npos) {
+      bad_baseline(path);
+    }
+
+    return atof(json.c_str() + found + key.size());
+  }
+
+  [[noreturn]] static void bad_baseline(const std::string& path) {
+    std::cerr << "Cannot read the baseline " << path << std::endl;
+    exit(2);
+  }
+
+  int compare() const {
+    auto& out = json_ ? std::cerr : std::cout;
+    const auto baseline = read_baseline(baseline_);
+
+    auto regressions = 0;
+    char line[256];
+    snprintf(line, sizeof(line),
+             "\n%-36s %12s %12s %8s %8s %7s %7s %7s %7s  %s\n", "benchmark",
+             "base (ns)", "median (ns)", "change", "p", "b.alloc", "allocs",
+             "b.copy", "copies", "");
+    out << line;
+    for (const auto& r : results_) {
+      auto it = baseline.find(r.name);
+      if (it == baseline.end()) {
+        continue;
+      }
+
+      const auto& b = it->second;
+      const auto change = b.median ? r.median / b.median - 1 : 0;
+      const auto slower = mann_whitney(b.times, r.times);
+      const auto faster = mann_whitney(r.times, b.times);
+
+      std::string verdict;
+      if (change > noise_ && slower < alpha_) {
+        verdict = "REGRESSION";
+      } else if (r.allocations > b.allocations) {
+        verdict = "REGRESSION (allocations)";
+      } else if (b.copies >= 0 && r.copies > b.copies) {
+        verdict = "REGRESSION (copies)";
+      } else if (change < -noise_ && faster < alpha_) {
+        verdict = "improvement";
+      }
+
+      regressions += verdict.compare(0, 10, "REGRESSION") == 0;
+      snprintf(line, sizeof(line),
+               "%-36s %12.0f %12.0f %+7.1f%% %8.4f %7.0f %7.0f %7s %7s  %s\n",
+               r.name.c_str(), b.median, r.median, change * 100,
+               change > 0 ? slower : faster, b.allocations, r.allocations,
+               count_text(b.copies).c_str(), count_text(r.copies).c_str(),
+               verdict.c_str());
+      out << line;
+    }
+
+    out << regressions << " regression(s)." << std::endl;
+    return regressions ? 1 : 0;
+  }
+
+  bool json_;
+  std::string filter_;
+  std::string save_;
+  std::string baseline_;
+  int repetitions_;
+  int warmup_;
+  double noise_;
+  double alpha_;
+  bool counting_copies_;
+  std::vector<Result> results_;
+};
+
+}  // namespace bench
+}  // namespace fn
+
+#endif  // FUNC_BENCH_BENCH_H_
@@ -0,0 +1,321 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+// Benchmarks each View operator on several roots, next to the equivalent
+// hand-written loop ("loop") and <algorithm> code ("stl").
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "bench/bench.h"
+#include "fn/fn.h"
+#include "fn/range.h"
+
+using fn::_;
+using fn::bench::Counted;
+using fn::bench::Suite;
+
+namespace {
+
+bool is_even(int i) { return i % 2 == 0; }
+
+// Benchmarks the operators on a root view of c, which holds 0, 1, ..., n - 1.
+// The elements are ints, or Counted when counting copies.
+template <template <typename...> class C, typename E>
+void bench_root(Suite* suite, const std::string& root, const C<E>& c) {
+  const auto n = static_cast<int>(c.size());
+  const auto prefix = root + "/" + std::to_string(n) + "/";
+  auto run = [&](const std::string& name, std::function<long()> f) {
+    suite->run(prefix + name, n, f);
+  };
+
+  // filter: the sum of even numbers.
+  run("filter/fn", [&] {
+    long sum = 0;
+    _(&c).filter(is_even).for_each([&sum](int i) { sum += i; });
+    return sum;
+  });
+  run("filter/loop", [&] {
+    long sum = 0;
+    for (auto i : c) {
+      if (is_even(i)) {
+        sum += i;
+      }
+    }
+    return sum;
+  });
+  run("filter/stl", [&] {
+    return std::accumulate(c.begin(), c.end(), 0L, [](long sum, int i) {
+      return is_even(i) ? sum + i : sum;
+    });
+  });
+
+  // map: the sum of tripled numbers.
+  run("map/fn", [&] {
+    long sum = 0;
+    _(&c).map([](const E& e) { return 3L * int(e); }).for_each([&sum](long i) {
+      sum += i;
+    });
+    return sum;
+  });
+  run("map/loop", [&] {
+    long sum = 0;
+    for (auto i : c) {
+      sum += 3L * i;
+    }
+    return sum;
+  });
+  run("map/stl", [&] {
+    return std::accumulate(c.begin(), c.end(), 0L,
+                           [](long sum, int i) { return sum + 3L * i; });
+  });
+
+  // flat_map: the sum of each number and its negation.
+  run("flat_map/fn", [&] {
+    long sum = 0;
+    _(&c).flat_map([](const E& e) {
+           const int i = e;
+           return std::array<int, 2>{{i, -i}};
+         })
+        .for_each([&sum](int i) { sum += i; });
+    return sum;
+  });
+  run("flat_map/loop", [&] {
+    long sum = 0;
+    for (auto i : c) {
+      for (auto j : std::array<int, 2>{{i, -i}}) {
+        sum += j;
+      }
+    }
+    return sum;
+  });
+  run("flat_map/stl", [&] {
+    long sum = 0;
+    std::for_each(c.begin(), c.end(), [&sum](int i) {
+      const std::array<int, 2> inner{{i, -i}};
+      sum = std::accumulate(inner.begin(), inner.end(), sum);
+    });
+    return sum;
+  });
+
+  // zip: the sum of squares, zipping the root with itself.
+  run("zip/fn", [&] {
+    long sum = 0;
+    _(&c).zip(_(&c)).for_each([&sum](const std::pair<int, int>& p) {
+      sum += long(p.first) * p.second;
+    });
+    return sum;
+  });
+  run("zip/loop", [&] {
+    long sum = 0;
+    auto i = c.begin();
+    for (auto j = c.begin(); i != c.end() && j != c.end(); ++i, ++j) {
+      sum += long(*i) * *j;
+    }
+    return sum;
+  });
+  run("zip/stl", [&] {
+    return std::inner_product(c.begin(), c.end(), c.begin(), 0L);
+  });
+
+  // fold_left and reduce: the sum.
+  run("fold_left/fn", [&] {
+    return _(&c).fold_left(0L, [](long sum, int i) { return sum + i; });
+  });
+  run("reduce/fn", [&] {
+    return long(_(&c).reduce([](int a, int b) { return a + b; }));
+  });
+  run("fold_left/loop", [&] {
+    long sum = 0;
+    for (auto i : c) {
+      sum += i;
+    }
+    return sum;
+  });
+  run("fold_left/stl", [&] { return std::accumulate(c.begin(), c.end(), 0L); });
+
+  // skip_until: the sum of the second half.
+  run("skip_until/fn", [&] {
+    long sum = 0;
+    _(&c).skip_until([n](int i) { return i >= n / 2; }).for_each([&sum](int i) {
+      sum += i;
+    });
+    return sum;
+  });
+  run("skip_until/loop", [&] {
+    long sum = 0;
+    bool skipping = true;
+    for (auto i : c) {
+      skipping = skipping && i < n / 2;
+      if (!skipping) {
+        sum += i;
+      }
+    }
+    return sum;
+  });
+  run("skip_until/stl", [&] {
+    auto from =
+        std::find_if(c.begin(), c.end(), [n](int i) { return i >= n / 2; });
+    return std::accumulate(from, c.end(), 0L);
+  });
+
+  // keep_while: the sum of the first half.
+  run("keep_while/fn", [&] {
+    long sum = 0;
+    _(&c).keep_while([n](int i) { return i < n / 2; }).for_each([&sum](int i) {
+      sum += i;
+    });
+    return sum;
+  });
+  run("keep_while/loop", [&] {
+    long sum = 0;
+    for (auto i : c) {
+      if (i >= n / 2) {
+        break;
+      }
+
+      sum += i;
+    }
+    return sum;
+  });
+  run("keep_while/stl", [&] {
+    auto to = std::find_if_not(c.begin(), c.end(),
+                               [n](int i) { return i < n / 2; });
+    return std::accumulate(c.begin(), to, 0L);
+  });
+
+  // evaluate: the even numbers in a vector.
+  run("evaluate/fn", [&] {
+    std::vector<E> v;
+    _(&c).filter(is_even).evaluate(&v);
+    return long(v.size());
+  });
+  run("evaluate/loop", [&] {
+    std::vector<E> v;
+    for (auto i : c) {
+      if (is_even(i)) {
+        v.push_back(i);
+      }
+    }
+    return long(v.size());
+  });
+  run("evaluate/stl", [&] {
+    std::vector<E> v;
+    std::copy_if(c.begin(), c.end(), std::back_inserter(v), is_even);
+    return long(v.size());
+  });
+
+  // as_set: the distinct residues modulo 1024.
+  run("as_set/fn", [&] {
+    return long(
+        _(&c).map([](const E& e) { return int(e) % 1024; }).as_set().size());
+  });
+  run("as_set/loop", [&] {
+    std::unordered_set<int> s;
+    for (auto i : c) {
+      s.insert(i % 1024);
+    }
+    return long(s.size());
+  });
+  run("as_set/stl", [&] {
+    std::unordered_set<int> s;
+    std::transform(c.begin(), c.end(), std::inserter(s, s.end()),
+                   [](int i) { return i % 1024; });
+    return long(s.size());
+  });
+
+  // as_map: a number for each residue modulo 1024.
+  run("as_map/fn", [&] {
+    return long(_(&c).map([](const E& e) {
+                       const int i = e;
+                       return std::make_pair(i % 1024, i);
+                     })
+                    .template as_map<int, int>()
+                    .size());
+  });
+  run("as_map/loop", [&] {
+    std::unordered_map<int, int> m;
+    for (auto i : c) {
+      m.insert(std::make_pair(i % 1024, i));
+    }
+    return long(m.size());
+  });
+  run("as_map/stl", [&] {
+    std::unordered_map<int, int> m;
+    std::transform(c.begin(), c.end(), std::inserter(m, m.end()),
+                   [](int i) { return std::make_pair(i % 1024, i); });
+    return long(m.size());
+  });
+
+  // Iteration: the sum of even numbers, using the iterators of a view.
+  run("iteration/fn", [&] {
+    long sum = 0;
+    for (auto i : _(&c).filter(is_even)) {
+      sum += i;
+    }
+    return sum;
+  });
+  run("iteration/stl", [&] {
+    long sum = 0;
+    std::for_each(c.begin(), c.end(), [&sum](int i) {
+      if (is_even(i)) {
+        sum += i;
+      }
+    });
+    return sum;
+  });
+}
+
+template <template <typename...> class C, typename E = int>
+C<E> iota(int n) {
+  C<E> c;
+  for (auto i = 0; i < n; i++) {
+    c.push_back(i);
+  }
+
+  return c;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Suite suite(argc, argv);
+  for (auto n : {1000, 100000, 1000000}) {
+    bench_root(&suite, "vector", iota<std::vector>(n));
+    bench_root(&suite, "list", iota<std::list>(n));
+    bench_root(&suite, "deque", iota<std::deque>(n));
+    bench_root(&suite, "range", fn::range(0, n));
+  }
+
+  // Copies are counted on roots of Counted elements. Ranges produce their
+  // elements, so there is nothing to count.
+  suite.count_copies(true);
+  for (auto n : {1000, 100000, 1000000}) {
+    bench_root(&suite, "vector", iota<std::vector, Counted>(n));
+    bench_root(&suite, "list", iota<std::list, Counted>(n));
+    bench_root(&suite, "deque", iota<std::deque, Counted>(n));
+  }
+
+  return suite.finish();
+}
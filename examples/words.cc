@@ -37,8 +37,18 @@ void word_count() {
   }
 }
 
+void word_frequency() {
+  const std::string text = "the map of the fold\nof the filter";
+  auto counts = _({fn::StringView(text)}).split().count_by();
+  for (const char* word : {"the", "of", "map"}) {
+    printf("The word '%s' appears %zu time(s)\n", word,
+           counts[fn::StringView(word)]);
+  }
+}
+
 int main() {
   word_count();
+  word_frequency();
   return 0;
 }
 
@@ -0,0 +1,211 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_ADAPTIVE_H_
+#define FUNC_ADAPTIVE_H_
+
+#include <cstddef>
+
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "fn/details.h"
+#include "fn/expr.h"
+
+namespace fn {
+namespace details {
+
+// The function of a filter stage whose predicates are reordered at run time
+// (see View::adaptive()). Its predicate is usually a conjunction of fused
+// filters.
+template <typename F>
+struct AdaptiveFilter {
+  using Pred = F;
+
+  explicit AdaptiveFilter(const F& f) : pred(f) {}
+
+  template <typename A>
+  bool operator()(const A& a) const {
+    return pred(a);
+  }
+
+  F pred;
+};
+
+template <typename>
+struct is_adaptive_filter {
+  static const bool value = false;
+};
+
+template <typename F>
+struct is_adaptive_filter<AdaptiveFilter<F>> {
+  static const bool value = true;
+};
+
+// Filters fused into an adaptive filter are reordered along with the others.
+template <typename F, typename G>
+AdaptiveFilter<typename Conjoined<F, G>::type> conjoin(
+    const AdaptiveFilter<F>& a, const G& g) {
+  return AdaptiveFilter<typename Conjoined<F, G>::type>(conjoin(a.pred, g));
+}
+
+// Flattens a conjunction of predicates into a tuple of predicates.
+template <typename F>
+struct Flattened {
+  using type = std::tuple<F>;
+
+  static type get(const F& f) { return type(f); }
+};
+
+template <typename F1, typename F2>
+struct Flattened<Conjunction<F1, F2>> {
+  using type = decltype(
+      std::tuple_cat(std::declval<typename Flattened<F1>::type>(),
+                     std::declval<typename Flattened<F2>::type>()));
+
+  static type get(const Conjunction<F1, F2>& c) {
+    return std::tuple_cat(Flattened<F1>::get(c.first),
+                          Flattened<F2>::get(c.second));
+  }
+};
+
+// Adjacent expression filters are fused into a single &&, whose operands are
+// reordered like separate filters.
+template <typename L, typename R>
+struct Flattened<Binary<AndOp, L, R>> {
+  using type = decltype(
+      std::tuple_cat(std::declval<typename Flattened<L>::type>(),
+                     std::declval<typename Flattened<R>::type>()));
+
+  static type get(const Binary<AndOp, L, R>& b) {
+    return std::tuple_cat(Flattened<L>::get(b.left),
+                          Flattened<R>::get(b.right));
+  }
+};
+
+// Every kAdaptivePeriod elements, the next kAdaptiveSample elements are used to
+// measure the pass rate and the cost of the predicates of an adaptive filter.
+const size_t kAdaptiveSample = 1024;
+const size_t kAdaptivePeriod = 256 * 1024;
+
+// Evaluates the tuple of predicates of an adaptive filter for elements of type
+// E, in the order that rejects the most elements per nanosecond. While
+// sampling, all predicates are evaluated for each element.
+template <typename Tuple, typename E>
+class AdaptiveOrder {
+ public:
+  static const size_t kSize = std::tuple_size<Tuple>::value;
+
+  explicit AdaptiveOrder(const Tuple& preds) : preds_(preds), seen_(0) {
+    for (size_t i = 0; i < kSize; i++) {
+      order_[i] = i;
+    }
+    reset();
+  }
+
+  AdaptiveOrder(const AdaptiveOrder&) = delete;
+  AdaptiveOrder& operator=(const AdaptiveOrder&) = delete;
+
+  bool operator()(const E& e) {
+    auto phase = seen_++ % kAdaptivePeriod;
+    if (phase < kAdaptiveSample) {
+      auto all = sample(e);
+      if (phase == kAdaptiveSample - 1) {
+        reorder();
+      }
+      return all;
+    }
+
+    for (size_t i = 0; i < kSize; i++) {
+      if (!Call<0>::call(preds_, order_[i], e)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // The indices of the predicates in the order they are evaluated.
+  const size_t* order() const { return order_; }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+  using Nanos = std::chrono::duration<double, std::nano>;
+
+  // Calls the i-th predicate. Unlike calling through a function pointer, this
+  // lets the compiler inline the predicates, and the branches selecting them
+  // are well predicted once the order is fixed.
+  template <size_t I, typename = void>
+  struct Call {
+    static bool call(const Tuple& t, size_t i, const E& e) {
+      return i == I ? static_cast<bool>(std::get<I>(t)(e))
+                    : Call<I + 1>::call(t, i, e);
+    }
+  };
+
+  template <typename T>
+  struct Call<kSize - 1, T> {
+    static bool call(const Tuple& t, size_t, const E& e) {
+      return static_cast<bool>(std::get<kSize - 1>(t)(e));
+    }
+  };
+
+  // Reading the clock is not much cheaper than a predicate, so the clock is
+  // read once between two predicates rather than before and after each.
+  bool sample(const E& e) {
+    auto all = true;
+    auto start = Clock::now();
+    for (size_t i = 0; i < kSize; i++) {
+      auto pass = Call<0>::call(preds_, i, e);
+      auto end = Clock::now();
+      nanos_[i] += Nanos(end - start).count();
+      passed_[i] += pass;
+      all = all && pass;
+      start = end;
+    }
+    return all;
+  }
+
+  void reorder() {
+    double score[kSize];
+    for (size_t i = 0; i < kSize; i++) {
+      score[i] = (kAdaptiveSample - passed_[i]) / std::max(nanos_[i], 1.0);
+    }
+
+    std::stable_sort(order_, order_ + kSize, [&score](size_t a, size_t b) {
+      return score[a] > score[b];
+    });
+    reset();
+  }
+
+  void reset() {
+    for (size_t i = 0; i < kSize; i++) {
+      passed_[i] = 0;
+      nanos_[i] = 0;
+    }
+  }
+
+  const Tuple& preds_;
+  size_t order_[kSize];
+  size_t passed_[kSize];
+  double nanos_[kSize];
+  size_t seen_;
+};
+
+}  // namespace details
+}  // namespace fn
+
+#endif  // FUNC_ADAPTIVE_H_
@@ -0,0 +1,178 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_ARENA_INL_H_
+#define FUNC_ARENA_INL_H_
+
+#include <cstdint>
+
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <type_traits>
+
+namespace fn {
+
+inline Arena::Scope::Scope(Arena* arena) : previous_(Arena::current()) {
+  Arena::current_slot() = arena;
+}
+
+inline Arena::Scope::~Scope() { Arena::current_slot() = previous_; }
+
+inline Arena::Arena(size_t block_size)
+    : block_size_(block_size),
+      blocks_(nullptr),
+      ptr_(nullptr),
+      end_(nullptr),
+      used_(0),
+      finalizers_(nullptr) {}
+
+inline Arena::~Arena() {
+  reset();
+  if (blocks_ != nullptr) {
+    ::operator delete(blocks_);
+  }
+}
+
+inline void* Arena::allocate(size_t size, size_t align) {
+  auto p = reinterpret_cast<uintptr_t>(ptr_);
+  auto aligned = (p + align - 1) & ~(uintptr_t(align) - 1);
+  if (ptr_ == nullptr || aligned + size > reinterpret_cast<uintptr_t>(end_)) {
+    add_block(size + align);
+    p = reinterpret_cast<uintptr_t>(ptr_);
+    aligned = (p + align - 1) & ~(uintptr_t(align) - 1);
+  }
+
+  ptr_ = reinterpret_cast<char*>(aligned + size);
+  used_ += size;
+  return reinterpret_cast<void*>(aligned);
+}
+
+template <typename T, typename... Args>
+T* Arena::create(Args&&... args) {
+  auto t = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  add_finalizer(t, 1);
+  return t;
+}
+
+template <typename T, typename It>
+T* Arena::copy(It begin, It end, size_t* size) {
+  auto n = static_cast<size_t>(std::distance(begin, end));
+  auto objects = static_cast<T*>(allocate(sizeof(T) * std::max<size_t>(n, 1),
+                                          alignof(T)));
+  auto p = objects;
+  for (auto i = begin; i != end; ++i) {
+    new (p++) T(*i);
+  }
+
+  add_finalizer(objects, n);
+  *size = n;
+  return objects;
+}
+
+inline void Arena::reset() {
+  // Finalizers are allocated in the arena and are listed in the reverse order
+  // of creation.
+  for (auto f = finalizers_; f != nullptr; f = f->next) {
+    f->destroy(f->objects, f->n);
+  }
+  finalizers_ = nullptr;
+
+  // Keep the first block of the standard size around to avoid hitting the
+  // global allocator again for the next use of this arena. Blocks are listed
+  // from the most recent, and larger ones, made for large allocations, are
+  // freed so that a reset arena never holds more than one standard block.
+  Block* kept = nullptr;
+  auto b = blocks_;
+  while (b != nullptr) {
+    auto next = b->next;
+    if (b->size == block_size_) {
+      if (kept != nullptr) {
+        ::operator delete(kept);
+      }
+      kept = b;
+    } else {
+      ::operator delete(b);
+    }
+    b = next;
+  }
+
+  blocks_ = kept;
+  if (kept != nullptr) {
+    kept->next = nullptr;
+    ptr_ = reinterpret_cast<char*>(kept + 1);
+    end_ = reinterpret_cast<char*>(kept) + kept->size;
+  } else {
+    ptr_ = nullptr;
+    end_ = nullptr;
+  }
+  used_ = 0;
+}
+
+template <typename T>
+void Arena::destroy(void* objects, size_t n) {
+  auto t = static_cast<T*>(objects);
+  for (size_t i = 0; i < n; i++) {
+    t[i].~T();
+  }
+}
+
+template <typename T>
+void Arena::add_finalizer(T* objects, size_t n) {
+  if (std::is_trivially_destructible<T>::value || n == 0) {
+    return;
+  }
+
+  auto f = new (allocate(sizeof(Finalizer), alignof(Finalizer))) Finalizer;
+  f->destroy = &Arena::destroy<T>;
+  f->objects = objects;
+  f->n = n;
+  f->next = finalizers_;
+  finalizers_ = f;
+}
+
+inline void Arena::add_block(size_t min_size) {
+  auto size = std::max(block_size_, min_size + sizeof(Block));
+  auto b = static_cast<Block*>(::operator new(size));
+  b->next = blocks_;
+  b->size = size;
+  blocks_ = b;
+  ptr_ = reinterpret_cast<char*>(b + 1);
+  end_ = reinterpret_cast<char*>(b) + size;
+}
+
+inline Arena*& Arena::current_slot() {
+  static thread_local Arena* current = nullptr;
+  return current;
+}
+
+template <typename T>
+T* ArenaAllocator<T>::allocate(size_t n) {
+  if (arena_ == nullptr) {
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+}
+
+template <typename T>
+void ArenaAllocator<T>::deallocate(T* p, size_t /* n */) {
+  if (arena_ == nullptr) {
+    ::operator delete(p);
+  }
+}
+
+}  // namespace fn
+
+#endif  // FUNC_ARENA_INL_H_
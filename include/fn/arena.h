@@ -0,0 +1,171 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_ARENA_H_
+#define FUNC_ARENA_H_
+
+#include <cstddef>
+
+#include <deque>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace fn {
+
+// Arena is a bump-pointer allocator. Memory is carved out of large blocks, and
+// is only given back when the arena is reset or destroyed, all at once. Arenas
+// are not thread-safe: use one arena per thread (e.g., per request handler).
+//
+//   fn::Arena arena;
+//   auto evens = _(v, &arena).filter(is_even).as_vector(&arena);
+//   ...
+//   arena.reset();
+class Arena {
+ public:
+  // Installs an arena as the current arena of this thread for the lifetime of
+  // the scope. Intermediate containers built while evaluating views (and
+  // ArenaAllocators created without an explicit arena) use the current arena.
+  class Scope {
+   public:
+    explicit Scope(Arena* arena);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    Arena* previous_;
+  };
+
+  static const size_t kDefaultBlockSize = 64 * 1024;
+
+  explicit Arena(size_t block_size = kDefaultBlockSize);
+  ~Arena();
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // Allocates size bytes aligned to align.
+  void* allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+  // Creates an object in the arena. Its destructor is called on reset.
+  template <typename T, typename... Args>
+  T* create(Args&&... args);
+
+  // Copies [begin, end) into the arena and returns the number of elements
+  // copied in *size. Destructors are called on reset.
+  template <typename T, typename It>
+  T* copy(It begin, It end, size_t* size);
+
+  // Destroys all the objects created in the arena and frees the memory
+  // allocated since construction. The first block of the standard size is
+  // kept for reuse.
+  void reset();
+
+  // Number of bytes allocated since the last reset.
+  size_t used() const { return used_; }
+
+  // The arena installed by the innermost Scope of this thread, or nullptr.
+  static Arena* current() { return current_slot(); }
+
+ private:
+  struct Block {
+    Block* next;
+    size_t size;
+  };
+
+  struct Finalizer {
+    void (*destroy)(void* objects, size_t n);
+    void* objects;
+    size_t n;
+    Finalizer* next;
+  };
+
+  template <typename T>
+  static void destroy(void* objects, size_t n);
+
+  template <typename T>
+  void add_finalizer(T* objects, size_t n);
+
+  void add_block(size_t min_size);
+
+  static Arena*& current_slot();
+
+  size_t block_size_;
+  Block* blocks_;
+  char* ptr_;
+  char* end_;
+  size_t used_;
+  Finalizer* finalizers_;
+};
+
+// An STL allocator that allocates from an arena, and falls back to the global
+// allocator when there is no arena. Deallocation is a no-op for arenas.
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  ArenaAllocator() : arena_(Arena::current()) {}
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& that) : arena_(that.arena()) {}
+
+  T* allocate(size_t n);
+  void deallocate(T* p, size_t n);
+
+  Arena* arena() const { return arena_; }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& that) const {
+    return arena_ == that.arena();
+  }
+
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& that) const {
+    return arena_ != that.arena();
+  }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template <typename T>
+using ArenaList = std::list<T, ArenaAllocator<T>>;
+
+template <typename T>
+using ArenaDeque = std::deque<T, ArenaAllocator<T>>;
+
+template <typename T>
+using ArenaSet = std::unordered_set<T, std::hash<T>, std::equal_to<T>,
+                                    ArenaAllocator<T>>;
+
+template <typename K, typename V>
+using ArenaMap =
+    std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
+                       ArenaAllocator<std::pair<const K, V>>>;
+
+}  // namespace fn
+
+#include "fn/arena-inl.h"
+
+#endif  // FUNC_ARENA_H_
@@ -0,0 +1,167 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_ASYNC_INL_H_
+#define FUNC_ASYNC_INL_H_
+
+namespace fn {
+namespace details {
+
+// The number of times a thread polls the queue before blocking.
+const int kAsyncSpins = 64;
+
+template <typename E>
+AsyncQueue<E>::AsyncQueue()
+    : head_(0), tail_(0), done_(false), cancelled_(false), sleepers_(0) {
+  batch_.reserve(kAsyncBatchSize);
+}
+
+template <typename E>
+template <typename P>
+void AsyncQueue<E>::wait(P ready) {
+  for (int spins = 0; spins < kAsyncSpins; spins++) {
+    if (ready()) {
+      return;
+    }
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  sleepers_.fetch_add(1);
+  while (!ready()) {
+    wakeup_.wait(lock);
+  }
+
+  sleepers_.fetch_sub(1);
+}
+
+template <typename E>
+void AsyncQueue<E>::wake() {
+  if (sleepers_.load() > 0) {
+    // Taking the lock orders this after the sleeper's last check of ready().
+    std::lock_guard<std::mutex> lock(mutex_);
+    wakeup_.notify_all();
+  }
+}
+
+template <typename E>
+void AsyncQueue<E>::publish() {
+  const size_t tail = tail_.load(std::memory_order_relaxed);
+  wait([&] {
+    return cancelled_.load() || tail - head_.load() < kAsyncBatches;
+  });
+
+  if (cancelled_.load(std::memory_order_relaxed)) {
+    throw AsyncCancelled();
+  }
+
+  // The slot gets the batch, and the producer the batch last consumed from
+  // the slot, if any.
+  slots_[tail % kAsyncBatches].swap(batch_);
+  batch_.clear();
+  tail_.store(tail + 1);
+  wake();
+}
+
+template <typename E>
+void AsyncQueue<E>::finish(std::exception_ptr error) {
+  if (!batch_.empty()) {
+    try {
+      publish();
+    } catch (const AsyncCancelled&) {
+    }
+  }
+
+  error_ = error;
+  done_.store(true);
+  wake();
+}
+
+template <typename E>
+bool AsyncQueue<E>::pop(std::vector<E>* batch) {
+  const size_t head = head_.load(std::memory_order_relaxed);
+  wait([&] { return head != tail_.load() || done_.load(); });
+
+  // The last batches are published before done_ is set, so the tail is read
+  // again in case it was.
+  if (head == tail_.load(std::memory_order_acquire)) {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+
+    return false;
+  }
+
+  batch->swap(slots_[head % kAsyncBatches]);
+  head_.store(head + 1);
+  wake();
+  return true;
+}
+
+template <typename E>
+AsyncRun<E>::AsyncRun(std::function<void(AsyncQueue<E>*)> producer) {
+  thread_ = std::thread([this, producer]() {
+    std::exception_ptr error;
+    try {
+      producer(&queue_);
+    } catch (const AsyncCancelled&) {
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    queue_.finish(error);
+  });
+}
+
+template <typename E>
+AsyncRun<E>::~AsyncRun() {
+  queue_.cancel();
+  thread_.join();
+}
+
+}  // namespace details
+
+template <typename E>
+Async<E>::Iterator::Iterator(const Producer* producer) : index_(0) {
+  if (producer) {
+    run_ = std::make_shared<details::AsyncRun<E>>(*producer);
+    next_batch();
+  }
+}
+
+template <typename E>
+void Async<E>::Iterator::next_batch() {
+  index_ = 0;
+  while (run_->next()) {
+    if (!run_->batch().empty()) {
+      return;
+    }
+  }
+
+  run_.reset();
+}
+
+template <typename E>
+template <typename G>
+void Async<E>::for_each(G& g) const {
+  details::AsyncRun<E> run(*producer_);
+  while (run.next()) {
+    for (const auto& e : run.batch()) {
+      g(e);
+    }
+  }
+}
+
+}  // namespace fn
+
+#endif  // FUNC_ASYNC_INL_H_
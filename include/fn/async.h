@@ -0,0 +1,201 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_ASYNC_H_
+#define FUNC_ASYNC_H_
+
+#include <cstddef>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fn {
+
+// The number of elements in each batch handed from a thread to the next by
+// View::async(), and the number of batches in flight.
+const size_t kAsyncBatchSize = 1024;
+const size_t kAsyncBatches = 16;
+
+namespace details {
+
+// Thrown in the producer when the consumer stops early, to unwind it.
+struct AsyncCancelled {};
+
+// A bounded lock-free queue of batches of elements from one producer thread to
+// one consumer thread. The producer fills a batch of its own, and swaps it
+// into a free slot of the ring when full, waiting while the ring is full. The
+// consumer swaps its consumed batch for the next one, so batches are reused.
+// A thread waiting on the other spins for a while, then blocks on a condition
+// variable, which the other thread notifies only while someone sleeps on it.
+template <typename E>
+class AsyncQueue {
+ public:
+  AsyncQueue();
+
+  AsyncQueue(const AsyncQueue&) = delete;
+  AsyncQueue& operator=(const AsyncQueue&) = delete;
+
+  // Called by the producer. Throws AsyncCancelled if the consumer stopped.
+  void push(const E& e) {
+    if (cancelled_.load(std::memory_order_relaxed)) {
+      throw AsyncCancelled();
+    }
+
+    batch_.push_back(e);
+    if (batch_.size() == kAsyncBatchSize) {
+      publish();
+    }
+  }
+
+  // Called by the producer last, with the exception it ended with, if any.
+  void finish(std::exception_ptr error);
+
+  // Called by the consumer. Replaces batch with the next one, and returns
+  // false at the end of the stream instead. Rethrows the exception of the
+  // producer, if any, at the end of the stream.
+  bool pop(std::vector<E>* batch);
+
+  // Called by the consumer to stop the producer early.
+  void cancel() {
+    cancelled_.store(true);
+    wake();
+  }
+
+ private:
+  void publish();
+
+  // Waits until ready() holds, spinning for a while and then blocking.
+  template <typename P>
+  void wait(P ready);
+
+  // Wakes the other thread if it is blocked in wait(). Called after each
+  // change of the state it waits on, which must be sequentially consistent
+  // so that either the sleeper sees the change or this sees the sleeper.
+  void wake();
+
+  std::vector<E> slots_[kAsyncBatches];
+  std::vector<E> batch_;
+
+  // Slots [head_, tail_) (modulo kAsyncBatches) hold batches to consume.
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+  std::atomic<bool> done_;
+  std::atomic<bool> cancelled_;
+  std::exception_ptr error_;
+
+  std::atomic<int> sleepers_;
+  std::mutex mutex_;
+  std::condition_variable wakeup_;
+};
+
+// A producer running on a thread of its own, and the batches it produced.
+// Destroying it stops the producer.
+template <typename E>
+class AsyncRun {
+ public:
+  explicit AsyncRun(std::function<void(AsyncQueue<E>*)> producer);
+  ~AsyncRun();
+
+  AsyncRun(const AsyncRun&) = delete;
+  AsyncRun& operator=(const AsyncRun&) = delete;
+
+  // Moves to the next batch, returning false at the end of the stream.
+  // Rethrows the exception of the producer, if any.
+  bool next() { return queue_.pop(&batch_); }
+
+  const std::vector<E>& batch() const { return batch_; }
+
+ private:
+  AsyncQueue<E> queue_;
+  std::vector<E> batch_;
+  std::thread thread_;
+};
+
+}  // namespace details
+
+// The elements of a view evaluated on a thread of its own, as created by
+// View::async(). Each evaluation, or each iteration from begin(), starts a new
+// thread running the view, which is joined when done.
+template <typename E>
+class Async {
+ public:
+  using value_type = E;
+  using Producer = std::function<void(details::AsyncQueue<E>*)>;
+
+  class Iterator : public std::iterator<std::input_iterator_tag, E> {
+   public:
+    // Starts a thread running producer, or creates an end iterator if null.
+    explicit Iterator(const Producer* producer);
+
+    const E& operator*() const { return run_->batch()[index_]; }
+
+    Iterator& operator++() {
+      if (++index_ == run_->batch().size()) {
+        next_batch();
+      }
+
+      return *this;
+    }
+
+    bool operator==(const Iterator& that) const {
+      return run_ == that.run_ && index_ == that.index_;
+    }
+
+    bool operator!=(const Iterator& that) const { return !(*this == that); }
+
+   private:
+    void next_batch();
+
+    std::shared_ptr<details::AsyncRun<E>> run_;
+    size_t index_;
+  };
+
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+
+  explicit Async(Producer producer)
+      : producer_(std::make_shared<const Producer>(std::move(producer))) {}
+
+  Iterator begin() const { return Iterator(producer_.get()); }
+  Iterator end() const { return Iterator(nullptr); }
+
+  // Calls g for each element, a batch at a time.
+  template <typename G>
+  void for_each(G& g) const;
+
+ private:
+  std::shared_ptr<const Producer> producer_;
+};
+
+namespace details {
+
+template <typename E, typename G>
+void for_each_element(const Async<E>& c, G& g) {
+  c.for_each(g);
+}
+
+}  // namespace details
+
+}  // namespace fn
+
+#include "fn/async-inl.h"
+
+#endif  // FUNC_ASYNC_H_
@@ -0,0 +1,206 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_BITMAP_H_
+#define FUNC_BITMAP_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+#include "fn/details.h"
+
+namespace fn {
+namespace details {
+
+// The function of a filter stage evaluated using bitmaps (see View::bitmap()).
+// Its predicate is usually a conjunction of fused filters.
+template <typename F>
+struct BitmapFilter {
+  explicit BitmapFilter(const F& f) : pred(f) {}
+
+  template <typename A>
+  bool operator()(const A& a) const {
+    return pred(a);
+  }
+
+  F pred;
+};
+
+template <typename>
+struct is_bitmap_filter {
+  static const bool value = false;
+};
+
+template <typename F>
+struct is_bitmap_filter<BitmapFilter<F>> {
+  static const bool value = true;
+};
+
+// Filters fused into a bitmap filter are evaluated using the bitmap as well.
+template <typename F, typename G>
+BitmapFilter<typename Conjoined<F, G>::type> conjoin(const BitmapFilter<F>& b,
+                                                     const G& g) {
+  return BitmapFilter<typename Conjoined<F, G>::type>(conjoin(b.pred, g));
+}
+
+// Whether a filter stage with function F on parent P is evaluated using
+// bitmaps: F is a bitmap filter and P is a root view on a contiguous container.
+template <typename P, typename F, typename = void>
+struct is_bitmap_stage {
+  static const bool value = false;
+};
+
+template <typename P, typename F>
+struct is_bitmap_stage<
+    P, F, typename std::enable_if<
+              is_bitmap_filter<F>::value &&
+              std::is_same<void*, typename P::PView>::value &&
+              std::is_pointer<decltype(std::declval<
+                                       const typename P::Container&>()
+                                       .data())>::value>::type> {
+  static const bool value = true;
+};
+
+inline int count_trailing_zeros(uint64_t w) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(w);
+#else
+  int n = 0;
+  for (; !(w & 1); w >>= 1) {
+    n++;
+  }
+  return n;
+#endif
+}
+
+inline int popcount(uint64_t w) {
+#if defined(__GNUC__)
+  return __builtin_popcountll(w);
+#else
+  int n = 0;
+  for (; w; w &= w - 1) {
+    n++;
+  }
+  return n;
+#endif
+}
+
+// Evaluates a predicate into a bitmap with one bit per element. select() sets
+// the bits of all elements that satisfy the predicate, and refine() clears the
+// bits of those that do not, evaluating the predicate only for the bits that
+// are still set. A conjunction selects using its first predicate and refines
+// using the rest, so every predicate sees the same elements as it would in a
+// chain of filters.
+template <typename F>
+struct BitmapEval {
+  template <typename T>
+  static void select(const F& f, const T* data, size_t n, uint64_t* words) {
+    for (size_t w = 0; w * 64 < n; w++) {
+      auto base = data + w * 64;
+      auto m = std::min<size_t>(64, n - w * 64);
+
+      uint64_t bits = 0;
+      for (size_t j = 0; j < m; j++) {
+        bits |= uint64_t(static_cast<bool>(f(base[j]))) << j;
+      }
+      words[w] = bits;
+    }
+  }
+
+  template <typename T>
+  static void refine(const F& f, const T* data, size_t nwords,
+                     uint64_t* words) {
+    for (size_t w = 0; w < nwords; w++) {
+      auto base = data + w * 64;
+
+      uint64_t keep = 0;
+      for (auto bits = words[w]; bits; bits &= bits - 1) {
+        auto j = count_trailing_zeros(bits);
+        keep |= uint64_t(static_cast<bool>(f(base[j]))) << j;
+      }
+      words[w] &= keep;
+    }
+  }
+};
+
+template <typename F1, typename F2>
+struct BitmapEval<Conjunction<F1, F2>> {
+  template <typename T>
+  static void select(const Conjunction<F1, F2>& f, const T* data, size_t n,
+                     uint64_t* words) {
+    BitmapEval<F1>::select(f.first, data, n, words);
+    BitmapEval<F2>::refine(f.second, data, (n + 63) / 64, words);
+  }
+
+  template <typename T>
+  static void refine(const Conjunction<F1, F2>& f, const T* data,
+                     size_t nwords, uint64_t* words) {
+    BitmapEval<F1>::refine(f.first, data, nwords, words);
+    BitmapEval<F2>::refine(f.second, data, nwords, words);
+  }
+};
+
+// Number of bitmap words evaluated in each block. A block of 4096 elements is
+// filtered by all predicates before moving to the next, while it is in cache.
+const size_t kBitmapWords = 64;
+
+// Calls b(block, words, nwords) for each block of [data, data + n) with the
+// bitmap of the elements satisfying pred.
+template <typename T, typename F, typename B>
+void for_each_bitmap(const T* data, size_t n, const F& pred, B b) {
+  uint64_t words[kBitmapWords];
+
+  for (size_t i = 0; i < n; i += kBitmapWords * 64) {
+    auto block = data + i;
+    auto m = std::min(kBitmapWords * 64, n - i);
+    BitmapEval<F>::select(pred, block, m, words);
+    b(block, static_cast<const uint64_t*>(words), (m + 63) / 64);
+  }
+}
+
+// Calls g for the elements of [data, data + n) that satisfy pred, visiting only
+// the set bits of the bitmap.
+template <typename T, typename F, typename G>
+void filter_bitmap(const T* data, size_t n, const F& pred, G& g) {
+  for_each_bitmap(data, n, pred,
+                  [&g](const T* block, const uint64_t* words, size_t nwords) {
+    for (size_t w = 0; w < nwords; w++) {
+      for (auto bits = words[w]; bits; bits &= bits - 1) {
+        g(block[w * 64 + count_trailing_zeros(bits)]);
+      }
+    }
+  });
+}
+
+// Returns the number of elements of [data, data + n) that satisfy pred.
+template <typename T, typename F>
+size_t count_bitmap(const T* data, size_t n, const F& pred) {
+  size_t count = 0;
+  for_each_bitmap(data, n, pred,
+                  [&count](const T*, const uint64_t* words, size_t nwords) {
+    for (size_t w = 0; w < nwords; w++) {
+      count += popcount(words[w]);
+    }
+  });
+  return count;
+}
+
+}  // namespace details
+}  // namespace fn
+
+#endif  // FUNC_BITMAP_H_
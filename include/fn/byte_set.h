@@ -0,0 +1,135 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_BYTE_SET_H_
+#define FUNC_BYTE_SET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "fn/bitmap.h"
+#include "fn/string_view.h"
+
+namespace fn {
+namespace details {
+
+// Text is classified in blocks of this many bytes, one bit per byte.
+const size_t kByteSetBlockSize = 64;
+
+// Sets of up to this many bytes are classified with SIMD instructions.
+const size_t kSimdByteSetSize = 8;
+
+// A set of bytes (e.g., delimiters), for finding them in text.
+class ByteSet {
+ public:
+  explicit ByteSet(StringView bytes);
+
+  // The number of bytes in the set.
+  size_t size() const { return size_; }
+
+  bool contains(char c) const {
+    const auto b = static_cast<unsigned char>(c);
+    return table_[b >> 6] >> (b & 63) & 1;
+  }
+
+  // Returns a bit per byte of the n <= 64 bytes at p, set for the bytes in the
+  // set. Bits past n are set.
+  uint64_t mask(const char* p, size_t n) const;
+
+  // Returns the position of the first byte in the set at or after pos, or the
+  // size of the text.
+  size_t find(StringView text, size_t pos) const;
+
+ private:
+  uint64_t table_[4];
+  char chars_[kSimdByteSetSize];
+  size_t size_;
+};
+
+inline ByteSet::ByteSet(StringView bytes) : table_{0, 0, 0, 0}, size_(0) {
+  for (const char c : bytes) {
+    if (contains(c)) {
+      continue;
+    }
+
+    const auto b = static_cast<unsigned char>(c);
+    table_[b >> 6] |= uint64_t(1) << (b & 63);
+    if (size_ < kSimdByteSetSize) {
+      chars_[size_] = c;
+    }
+
+    size_++;
+  }
+}
+
+inline uint64_t ByteSet::mask(const char* p, size_t n) const {
+  const uint64_t past = n < kByteSetBlockSize ? ~0ULL << n : 0;
+#if defined(__SSE2__)
+  if (size_ <= kSimdByteSetSize) {
+    // Short blocks at the end of the text are classified from a padded copy.
+    char padded[kByteSetBlockSize];
+    if (n < kByteSetBlockSize) {
+      memset(padded, 0, kByteSetBlockSize);
+      memcpy(padded, p, n);
+      p = padded;
+    }
+
+    uint64_t m = 0;
+    for (size_t i = 0; i < kByteSetBlockSize / 16; i++) {
+      const __m128i b =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+      __m128i eq = _mm_setzero_si128();
+      for (size_t j = 0; j < size_; j++) {
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi8(b, _mm_set1_epi8(chars_[j])));
+      }
+
+      const uint16_t w = _mm_movemask_epi8(eq);
+      m |= static_cast<uint64_t>(w) << (16 * i);
+    }
+
+    return m | past;
+  }
+#endif
+
+  uint64_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    m |= static_cast<uint64_t>(contains(p[i])) << i;
+  }
+
+  return m | past;
+}
+
+inline size_t ByteSet::find(StringView text, size_t pos) const {
+  for (; pos < text.size(); pos += kByteSetBlockSize) {
+    const size_t n = std::min(text.size() - pos, kByteSetBlockSize);
+    const uint64_t m = mask(text.data() + pos, n);
+    if (m != 0) {
+      return std::min(pos + count_trailing_zeros(m), text.size());
+    }
+  }
+
+  return text.size();
+}
+
+}  // namespace details
+}  // namespace fn
+
+#endif  // FUNC_BYTE_SET_H_
@@ -0,0 +1,50 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_COLUMNS_INL_H_
+#define FUNC_COLUMNS_INL_H_
+
+#include <cassert>
+
+namespace fn {
+
+template <typename... Ts>
+Columns<Row<Ts...>>::Columns(const std::vector<Ts>&... columns)
+    : table_(std::make_shared<const typename Row<Ts...>::Table>(
+          columns.data()...)),
+      size_(0) {
+  size_t sizes[] = {columns.size()...};
+  size_ = sizes[0];
+  for (auto s : sizes) {
+    assert(s == size_ && "Columns should have the same size.");
+    (void)s;
+  }
+}
+
+template <typename... Ts>
+template <size_t I>
+Span<typename Row<Ts...>::template Field<I>> Columns<Row<Ts...>>::column()
+    const {
+  return Span<typename Row<Ts...>::template Field<I>>(std::get<I>(*table_),
+                                                       size_);
+}
+
+template <typename... Ts>
+Columns<Row<Ts...>> columns(const std::vector<Ts>&... cols) {
+  return Columns<Row<Ts...>>(cols...);
+}
+
+}  // namespace fn
+
+#endif  // FUNC_COLUMNS_INL_H_
@@ -0,0 +1,182 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_COLUMNS_H_
+#define FUNC_COLUMNS_H_
+
+#include <cstddef>
+
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "fn/details.h"
+#include "fn/span.h"
+
+namespace fn {
+
+// Row is a lightweight reference to the i-th row of a set of parallel columns:
+// a pointer to the table of the columns, and an index. Accessing a field only
+// reads the column of that field. The table is shared by the copies of the
+// Columns, so rows stay valid after the views they come from, as long as a
+// copy of their Columns (e.g., the one they were created with) is alive.
+template <typename... Ts>
+class Row {
+ public:
+  using Table = std::tuple<const Ts*...>;
+
+  template <size_t I>
+  using Field = typename std::tuple_element<I, std::tuple<Ts...>>::type;
+
+  Row() : table_(nullptr), index_(0) {}
+  Row(const Table* table, size_t index) : table_(table), index_(index) {}
+
+  // Returns the I-th field of the row.
+  template <size_t I>
+  const Field<I>& get() const {
+    return std::get<I>(*table_)[index_];
+  }
+
+  // Returns the index of the row in the columns.
+  size_t index() const { return index_; }
+
+ private:
+  const Table* table_;
+  size_t index_;
+};
+
+// Views on columns name Columns<E> as the container of their stages. Only
+// Columns of rows are ever constructed.
+template <typename R>
+class Columns {};
+
+// Columns stores elements in a struct-of-arrays layout: a set of parallel
+// columns, each in a contiguous vector. Its elements are Rows. Columns does not
+// own the vectors, so they should outlive the columns and views on them.
+//
+//   auto cols = fn::columns(ts, user_id, value);
+//   auto total = _(cols).filter([](const Row& r) { return r.get<1>() == 7; })
+//                       .map(fn::column<2>())
+//                       .sum();
+template <typename... Ts>
+class Columns<Row<Ts...>> {
+ public:
+  using value_type = Row<Ts...>;
+
+  class Iterator : public std::iterator<std::forward_iterator_tag,
+                                        Row<Ts...>> {
+   public:
+    Iterator(const typename Row<Ts...>::Table* table, size_t index)
+        : table_(table), index_(index) {}
+
+    Row<Ts...> operator*() const { return Row<Ts...>(table_, index_); }
+
+    Iterator& operator++() {
+      ++index_;
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      auto cp = *this;
+      ++index_;
+      return cp;
+    }
+
+    bool operator==(const Iterator& that) const {
+      return index_ == that.index_ && table_ == that.table_;
+    }
+
+    bool operator!=(const Iterator& that) const { return !(*this == that); }
+
+   private:
+    const typename Row<Ts...>::Table* table_;
+    size_t index_;
+  };
+
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+
+  explicit Columns(const std::vector<Ts>&... columns);
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Returns the I-th column.
+  template <size_t I>
+  Span<typename Row<Ts...>::template Field<I>> column() const;
+
+  Iterator begin() const { return Iterator(table_.get(), 0); }
+  Iterator end() const { return Iterator(table_.get(), size_); }
+
+ private:
+  // Allocated once, so that rows can point to it whichever copy they come
+  // from.
+  std::shared_ptr<const typename Row<Ts...>::Table> table_;
+  size_t size_;
+};
+
+// Creates columns on the given parallel vectors. All the vectors must have the
+// same size.
+template <typename... Ts>
+Columns<Row<Ts...>> columns(const std::vector<Ts>&... cols);
+
+// Projects rows to their I-th field. Mapping a view of Columns using a column
+// projection does not touch the rows at all: the result is a view on the
+// contiguous column.
+template <size_t I>
+struct ColumnProjection {
+  static const size_t index = I;
+
+  template <typename... Ts>
+  const typename Row<Ts...>::template Field<I>& operator()(
+      const Row<Ts...>& r) const {
+    return r.template get<I>();
+  }
+};
+
+template <size_t I>
+ColumnProjection<I> column() {
+  return ColumnProjection<I>();
+}
+
+namespace details {
+
+template <typename C, typename G>
+struct is_column_projection {
+  static const bool value = false;
+};
+
+template <typename R, size_t I>
+struct is_column_projection<Columns<R>, ColumnProjection<I>> {
+  static const bool value = true;
+};
+
+template <typename V, typename E, size_t I>
+struct MapFusion<V, E, ColumnProjection<I>, FuncType::FILTER, true> {
+  using type = typename std::conditional<
+      is_column_projection<typename V::Container,
+                           ColumnProjection<I>>::value,
+      typename V::template Root<Span, E>,
+      typename V::template Rebind<E, V, ColumnProjection<I>,
+                                  FuncType::MAP>>::type;
+};
+
+}  // namespace details
+}  // namespace fn
+
+#include "fn/columns-inl.h"
+
+#endif  // FUNC_COLUMNS_H_
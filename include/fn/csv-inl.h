@@ -0,0 +1,341 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_CSV_INL_H_
+#define FUNC_CSV_INL_H_
+
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "fn/bitmap.h"
+
+namespace fn {
+namespace details {
+
+// Delimited text is scanned in blocks of this many bytes, one bit per byte.
+const size_t kCsvBlockSize = 64;
+
+// The positions of the delimiters, quotes and newlines in a block.
+struct CsvMasks {
+  uint64_t delimiters;
+  uint64_t quotes;
+  uint64_t newlines;
+};
+
+// Finds the delimiters, quotes and newlines in the first n bytes at p.
+inline CsvMasks csv_masks(const char* p, size_t n, char delimiter) {
+  // Short blocks at the end of the text are scanned from a padded copy.
+  char padded[kCsvBlockSize];
+  if (n < kCsvBlockSize) {
+    memset(padded, 0, kCsvBlockSize);
+    memcpy(padded, p, n);
+    p = padded;
+  }
+
+#if defined(__AVX2__)
+  const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  const __m256i hi =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+  auto match = [&](char c) {
+    const __m256i v = _mm256_set1_epi8(c);
+    const uint32_t l = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v));
+    const uint32_t h = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v));
+    return static_cast<uint64_t>(h) << 32 | l;
+  };
+#elif defined(__SSE2__)
+  __m128i b[4];
+  for (int i = 0; i < 4; i++) {
+    b[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+  }
+
+  auto match = [&](char c) {
+    const __m128i v = _mm_set1_epi8(c);
+    uint64_t m = 0;
+    for (int i = 0; i < 4; i++) {
+      const uint16_t w = _mm_movemask_epi8(_mm_cmpeq_epi8(b[i], v));
+      m |= static_cast<uint64_t>(w) << (16 * i);
+    }
+
+    return m;
+  };
+#else
+  auto match = [&](char c) {
+    uint64_t m = 0;
+    for (size_t i = 0; i < kCsvBlockSize; i++) {
+      m |= static_cast<uint64_t>(p[i] == c) << i;
+    }
+
+    return m;
+  };
+#endif
+
+  const uint64_t valid = n < kCsvBlockSize ? (uint64_t(1) << n) - 1 : ~0ULL;
+  return CsvMasks{match(delimiter) & valid, match('"') & valid,
+                  match('\n') & valid};
+}
+
+// Sets each bit to the parity of the bits up to it: the bits between an odd
+// quote and the next one (ie, within quotes) are set.
+inline uint64_t prefix_xor(uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value, T>::type parse_field(
+    StringView s) {
+  size_t i = 0;
+  const bool negative = !s.empty() && s[0] == '-';
+  i += negative || (!s.empty() && s[0] == '+');
+
+  // The digits are accumulated unsigned, so that values out of the range of T
+  // wrap around instead of overflowing, and the lowest value can be negated.
+  using U = typename std::make_unsigned<T>::type;
+  U value = 0;
+  for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; i++) {
+    value = static_cast<U>(value * 10 + static_cast<U>(s[i] - '0'));
+  }
+
+  return static_cast<T>(negative ? static_cast<U>(0 - value) : value);
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value, T>::type
+parse_field(StringView s) {
+  // strtod needs a terminated string.
+  char number[64];
+  const size_t n = std::min(s.size(), sizeof(number) - 1);
+  memcpy(number, s.data(), n);
+  number[n] = '\0';
+  return static_cast<T>(strtod(number, nullptr));
+}
+
+template <typename T>
+typename std::enable_if<std::is_same<T, StringView>::value, T>::type
+parse_field(StringView s) {
+  return s;
+}
+
+template <typename T>
+typename std::enable_if<std::is_same<T, std::string>::value, T>::type
+parse_field(StringView s) {
+  return s.str();
+}
+
+}  // namespace details
+
+inline StringView CsvRow::operator[](size_t i) const {
+  if (i >= size_) {
+    return StringView();
+  }
+
+  const uint32_t begin = i == 0 ? 0 : ends_[i - 1] + 1;
+  const StringView field(data_ + begin, ends_[i] - begin);
+  if (field.size() >= 2 && field[0] == '"' && field[field.size() - 1] == '"') {
+    return field.substr(1, field.size() - 2);
+  }
+
+  return field;
+}
+
+template <typename T>
+T CsvRow::get(size_t i) const {
+  return details::parse_field<T>((*this)[i]);
+}
+
+template <typename E>
+Csv<E>::Iterator::Iterator(const char* pos, const char* end, char delimiter)
+    : row_begin_(pos), end_(end), delimiter_(delimiter) {
+  start();
+}
+
+template <typename E>
+Csv<E>::Iterator::Iterator(const Iterator& that)
+    : Iterator(that.row_begin_, that.end_, that.delimiter_) {}
+
+template <typename E>
+typename Csv<E>::Iterator& Csv<E>::Iterator::operator=(const Iterator& that) {
+  row_begin_ = that.row_begin_;
+  end_ = that.end_;
+  delimiter_ = that.delimiter_;
+  start();
+  return *this;
+}
+
+template <typename E>
+typename Csv<E>::Iterator& Csv<E>::Iterator::operator++() {
+  row_begin_ = row_end_;
+  find_row();
+  return *this;
+}
+
+template <typename E>
+typename Csv<E>::Iterator Csv<E>::Iterator::operator++(int) {
+  auto cp = *this;
+  ++*this;
+  return cp;
+}
+
+template <typename E>
+void Csv<E>::Iterator::start() {
+  // Rows start outside of quotes.
+  row_end_ = row_begin_;
+  block_ = row_begin_;
+  separators_ = 0;
+  newlines_ = 0;
+  in_quotes_ = 0;
+  if (row_begin_ != end_) {
+    load_block();
+  }
+
+  find_row();
+}
+
+template <typename E>
+void Csv<E>::Iterator::find_row() {
+  ends_.clear();
+  if (row_begin_ == end_) {
+    row_ = E();
+    return;
+  }
+
+  // Consumes the separators up to the first newline, or to the end.
+  row_end_ = end_;
+  for (;;) {
+    if (separators_ == 0) {
+      if (next_block()) {
+        continue;
+      }
+
+      ends_.push_back(end_ - row_begin_);
+      break;
+    }
+
+    const int bit = details::count_trailing_zeros(separators_);
+    separators_ &= separators_ - 1;
+    ends_.push_back(block_ + bit - row_begin_);
+    if (newlines_ >> bit & 1) {
+      row_end_ = block_ + bit + 1;
+      break;
+    }
+  }
+
+  auto& last = ends_.back();
+  const uint32_t begin = ends_.size() == 1 ? 0 : ends_[ends_.size() - 2] + 1;
+  if (last > begin && row_begin_[last - 1] == '\r') {
+    last--;
+  }
+
+  row_ = E(row_begin_, ends_.data(), ends_.size());
+}
+
+template <typename E>
+bool Csv<E>::Iterator::next_block() {
+  if (static_cast<size_t>(end_ - block_) <= details::kCsvBlockSize) {
+    block_ = end_;
+    return false;
+  }
+
+  block_ += details::kCsvBlockSize;
+  load_block();
+  return true;
+}
+
+template <typename E>
+void Csv<E>::Iterator::load_block() {
+  const size_t n = std::min<size_t>(end_ - block_, details::kCsvBlockSize);
+  const auto masks = details::csv_masks(block_, n, delimiter_);
+
+  // Quotes toggle the quoted state, which carries over to the next block.
+  const uint64_t quoted = details::prefix_xor(masks.quotes) ^ in_quotes_;
+  in_quotes_ = static_cast<uint64_t>(static_cast<int64_t>(quoted) >> 63);
+  newlines_ = masks.newlines & ~quoted;
+  separators_ = (masks.delimiters & ~quoted) | newlines_;
+}
+
+template <typename E>
+Csv<E>::Csv(std::shared_ptr<const MappedFile> file, const char* begin,
+            const char* end, char delimiter)
+    : file_(std::move(file)),
+      begin_(begin),
+      end_(end),
+      delimiter_(delimiter),
+      size_(static_cast<size_t>(-1)) {}
+
+template <typename E>
+Csv<E>::Csv(const Csv& that)
+    : file_(that.file_),
+      begin_(that.begin_),
+      end_(that.end_),
+      delimiter_(that.delimiter_),
+      size_(that.size_.load(std::memory_order_relaxed)) {}
+
+template <typename E>
+Csv<E>& Csv<E>::operator=(const Csv& that) {
+  file_ = that.file_;
+  begin_ = that.begin_;
+  end_ = that.end_;
+  delimiter_ = that.delimiter_;
+  size_.store(that.size_.load(std::memory_order_relaxed),
+              std::memory_order_relaxed);
+  return *this;
+}
+
+template <typename E>
+size_t Csv<E>::size() const {
+  size_t size = size_.load(std::memory_order_relaxed);
+  if (size == static_cast<size_t>(-1)) {
+    size = std::distance(begin(), end());
+    size_.store(size, std::memory_order_relaxed);
+  }
+
+  return size;
+}
+
+template <typename E>
+Csv<E> Csv<E>::skip(size_t n) const {
+  auto it = begin();
+  for (size_t i = 0; i < n && it != end(); i++) {
+    ++it;
+  }
+
+  return Csv(file_, it.row_begin_, end_, delimiter_);
+}
+
+inline Csv<> csv(StringView text, char delimiter) {
+  return Csv<>(nullptr, text.data(), text.data() + text.size(), delimiter);
+}
+
+inline Csv<> mmap_csv(const std::string& path, char delimiter) {
+  auto file = std::make_shared<const MappedFile>(path);
+  return Csv<>(file, file->data(), file->data() + file->size(), delimiter);
+}
+
+}  // namespace fn
+
+#endif  // FUNC_CSV_INL_H_
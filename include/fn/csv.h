@@ -0,0 +1,191 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_CSV_H_
+#define FUNC_CSV_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fn/mapped_file.h"
+#include "fn/string_view.h"
+
+namespace fn {
+
+// A row of delimited text (e.g., CSV or TSV): its characters, and the offset of
+// the end of each of its fields. Fields are not parsed until requested. A row
+// points into the buffer of the iterator that read it, and is only valid until
+// that iterator moves: map rows to the fields they are needed for, rather than
+// storing them.
+class CsvRow {
+ public:
+  CsvRow() : data_(nullptr), ends_(nullptr), size_(0) {}
+  CsvRow(const char* data, const uint32_t* ends, size_t size)
+      : data_(data), ends_(ends), size_(size) {}
+
+  // The number of fields.
+  size_t size() const { return size_; }
+
+  // The i-th field, without its enclosing quotes, or an empty view if there is
+  // no such field. Doubled quotes in quoted fields are not unescaped.
+  StringView operator[](size_t i) const;
+
+  // Parses the i-th field as an integer, a floating point number, a
+  // StringView or a string. Missing fields, and fields that are not numbers,
+  // are parsed as zero. Integers out of the range of T wrap around.
+  template <typename T>
+  T get(size_t i) const;
+
+  // The whole row, without its line terminator.
+  StringView line() const {
+    return StringView(data_, size_ == 0 ? 0 : ends_[size_ - 1]);
+  }
+
+ private:
+  const char* data_;
+  const uint32_t* ends_;
+  size_t size_;
+};
+
+// The rows of a buffer of delimited text, as rows of type E (e.g., CsvRow).
+// Fields are separated by a delimiter character, and rows by '\n' (optionally
+// preceded by '\r'). Delimiters and newlines within double quotes are part of
+// the field.
+//
+// Rows are found while iterating, 64 bytes at a time: the delimiters, quotes
+// and newlines of each block are found with SIMD instructions (SSE2 or AVX2,
+// when available) as bitmasks, and quoted regions are masked out with a prefix
+// XOR of the quotes. Nothing is allocated per row or per field.
+template <typename E = CsvRow>
+class Csv {
+ public:
+  class Iterator : public std::iterator<std::forward_iterator_tag, E> {
+   public:
+    Iterator(const char* pos, const char* end, char delimiter);
+
+    // Copies read the current row again, for their own row to point to their
+    // own buffer.
+    Iterator(const Iterator& that);
+    Iterator& operator=(const Iterator& that);
+
+    Iterator(Iterator&&) = default;
+    Iterator& operator=(Iterator&&) = default;
+
+    const E& operator*() const { return row_; }
+    const E* operator->() const { return &row_; }
+
+    Iterator& operator++();
+    Iterator operator++(int);
+
+    bool operator==(const Iterator& that) const {
+      return row_begin_ == that.row_begin_;
+    }
+
+    bool operator!=(const Iterator& that) const {
+      return row_begin_ != that.row_begin_;
+    }
+
+   private:
+    friend class Csv;
+
+    void start();
+    void find_row();
+    bool next_block();
+    void load_block();
+
+    const char* row_begin_;
+    const char* row_end_;
+    const char* block_;
+    const char* end_;
+    char delimiter_;
+
+    // The delimiters and newlines outside of quotes in the current block that
+    // have not been consumed yet, and whether the block ends within quotes.
+    uint64_t separators_;
+    uint64_t newlines_;
+    uint64_t in_quotes_;
+
+    std::vector<uint32_t> ends_;
+    E row_;
+  };
+
+  // For compability with stl.
+  using value_type = E;
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+
+  Csv(std::shared_ptr<const MappedFile> file, const char* begin,
+      const char* end, char delimiter);
+
+  Csv(const Csv& that);
+  Csv& operator=(const Csv& that);
+
+  Iterator begin() const { return Iterator(begin_, end_, delimiter_); }
+  Iterator end() const { return Iterator(end_, end_, delimiter_); }
+
+  // Counts the rows, which scans them the first time. Threads calling it at
+  // once may each scan them.
+  size_t size() const;
+  bool empty() const { return begin_ == end_; }
+
+  // Returns the rows after the first n (e.g., after a header).
+  Csv skip(size_t n) const;
+
+ private:
+  std::shared_ptr<const MappedFile> file_;
+  const char* begin_;
+  const char* end_;
+  char delimiter_;
+
+  // The number of rows once counted, or -1.
+  mutable std::atomic<size_t> size_;
+};
+
+// Projects rows to their index-th field, parsed as a T (see CsvRow::get()).
+// Only the projected field is parsed.
+template <typename T>
+struct FieldProjection {
+  explicit FieldProjection(size_t i) : index(i) {}
+
+  T operator()(const CsvRow& row) const { return row.get<T>(index); }
+
+  size_t index;
+};
+
+template <typename T>
+FieldProjection<T> col(size_t index) {
+  return FieldProjection<T>(index);
+}
+
+// Creates rows on the delimited text, which must outlive them:
+//
+//   auto sales = fn::csv(text).skip(1);
+//   auto total = _(sales).map(fn::col<int64_t>(3)).sum();
+Csv<> csv(StringView text, char delimiter = ',');
+
+// Maps the file at path in memory, for creating rows on its delimited text.
+// Throws std::system_error if the file cannot be mapped.
+Csv<> mmap_csv(const std::string& path, char delimiter = ',');
+
+}  // namespace fn
+
+#include "fn/csv-inl.h"
+
+#endif  // FUNC_CSV_H_
@@ -15,8 +15,15 @@
 #ifndef FUNC_DETAILS_H_
 #define FUNC_DETAILS_H_
 
+#include <cassert>
+#include <cstddef>
+
+#include <algorithm>
+#include <iterator>
 #include <memory>
+#include <new>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 
 namespace fn {
@@ -28,20 +35,25 @@ enum class FuncType {
   FOLD_LEFT,
   KEEP,
   MAP,
+  MAP_FILTER,
+  PROBE,
   SKIP,
   ZIP,
 };
 
 class Private;
 
-template <typename T>
-struct Copy {
-  Copy() : p() {}
-  explicit Copy(const T& t) : p(new T(t)) {}
-  explicit Copy(T&& t) : p(new T(std::move(t))) {}
+// Values up to this size are copied inline by Copy, if trivially copyable.
+const size_t kInlineCopySize = 4 * sizeof(void*);
+
+template <typename T, bool inlined>
+struct CopyStorage {
+  CopyStorage() : p() {}
+  explicit CopyStorage(const T& t) : p(new T(t)) {}
+  explicit CopyStorage(T&& t) : p(new T(std::move(t))) {}
 
-  Copy(const Copy& that) : p(that.p ? new T(*that.p) : nullptr) {}
-  Copy(Copy&&) = default;
+  CopyStorage(const CopyStorage& that) : p(that.p ? new T(*that.p) : nullptr) {}
+  CopyStorage(CopyStorage&&) = default;
 
   const T& operator*() const { return *p; }
   const T* operator->() const { return p.get(); }
@@ -52,6 +64,32 @@ struct Copy {
   std::unique_ptr<const T> p;
 };
 
+// Small trivially copyable values (e.g., ranges) are stored in place, so that
+// copying a view on them never allocates.
+template <typename T>
+struct CopyStorage<T, true> {
+  CopyStorage() : empty(true) {}
+  explicit CopyStorage(const T& t) : empty(false) { new (&storage) T(t); }
+
+  const T& operator*() const { return *operator->(); }
+  const T* operator->() const {
+    return empty ? nullptr : reinterpret_cast<const T*>(&storage);
+  }
+
+  bool operator!() const { return !static_cast<bool>(*this); }
+  explicit operator bool() const { return !empty; }
+
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  bool empty;
+};
+
+template <typename T>
+struct Copy : CopyStorage<T, sizeof(T) <= kInlineCopySize &&
+                                 std::is_trivially_copyable<T>::value> {
+  using CopyStorage<T, sizeof(T) <= kInlineCopySize &&
+                           std::is_trivially_copyable<T>::value>::CopyStorage;
+};
+
 template <typename T>
 struct Ref {
   Ref() : p(nullptr) {}
@@ -66,6 +104,99 @@ struct Ref {
   const T* p;
 };
 
+// The policies of roots known to be sorted by operator< (see fn::sorted()).
+template <typename T>
+struct SortedCopy : Copy<T> {
+  SortedCopy() {}
+  explicit SortedCopy(const T& t) : Copy<T>(t) {}
+  explicit SortedCopy(T&& t) : Copy<T>(std::move(t)) {}
+};
+
+template <typename T>
+struct SortedRef : Ref<T> {
+  SortedRef() {}
+  explicit SortedRef(const T& t) : Ref<T>(t) {}
+};
+
+template <template <typename...> class R>
+struct is_sorted_policy {
+  static const bool value = false;
+};
+
+template <>
+struct is_sorted_policy<SortedCopy> {
+  static const bool value = true;
+};
+
+template <>
+struct is_sorted_policy<SortedRef> {
+  static const bool value = true;
+};
+
+// A container, or a pointer to a container, known to be sorted. Passed to fn::_
+// to create a sorted root.
+template <typename T>
+struct Sorted {
+  T c;
+};
+
+// Whether the elements of a view with the given policy, parent and stage are
+// sorted. Filtering, skipping, keeping and probing elements preserves the
+// order of the parent.
+template <typename P, FuncType t,
+          bool preserves = t == FuncType::FILTER || t == FuncType::SKIP ||
+                           t == FuncType::KEEP || t == FuncType::PROBE>
+struct preserves_sorted {
+  static const bool value = false;
+};
+
+template <typename P, FuncType t>
+struct preserves_sorted<P, t, true> {
+  static const bool value = P::sorted;
+};
+
+template <template <typename...> class R, typename P, FuncType t>
+struct is_sorted_view {
+  static const bool value = preserves_sorted<P, t>::value;
+};
+
+template <template <typename...> class R, FuncType t>
+struct is_sorted_view<R, void*, t> {
+  static const bool value = is_sorted_policy<R>::value;
+};
+
+// Whether a view can evaluate only the elements in a range of values, using a
+// binary search on its root. Sorted roots, and filters and probes on them, can.
+template <typename P, FuncType t,
+          bool filter = t == FuncType::FILTER || t == FuncType::PROBE>
+struct preserves_sliceable {
+  static const bool value = false;
+};
+
+template <typename P, FuncType t>
+struct preserves_sliceable<P, t, true> {
+  static const bool value = P::sliceable;
+};
+
+template <template <typename...> class R, typename P, FuncType t>
+struct is_sliceable_view {
+  static const bool value = preserves_sliceable<P, t>::value;
+};
+
+template <template <typename...> class R, FuncType t>
+struct is_sliceable_view<R, void*, t> {
+  static const bool value = is_sorted_policy<R>::value;
+};
+
+// Calls g for each element of the container of a root view. Containers that
+// decode their elements in blocks overload it to loop over each block.
+template <typename C, typename G>
+void for_each_element(const C& c, G& g) {
+  for (const auto& e : c) {
+    g(e);
+  }
+}
+
 template <typename>
 struct is_pair {
   static const bool value = false;
@@ -76,6 +207,334 @@ struct is_pair<std::pair<F, S>> {
   static const bool value = true;
 };
 
+// A predicate that holds when both first and second hold. Adjacent filters are
+// fused into a single stage using this predicate.
+template <typename F1, typename F2>
+struct Conjunction {
+  Conjunction(const F1& f1, const F2& f2) : first(f1), second(f2) {}
+
+  template <typename A>
+  bool operator()(const A& a) const {
+    return first(a) && second(a);
+  }
+
+  F1 first;
+  F2 second;
+};
+
+// Applies first and then second. Adjacent maps are fused into a single stage
+// using this function.
+template <typename F1, typename F2>
+struct Composition {
+  Composition(const F1& f1, const F2& f2) : first(f1), second(f2) {}
+
+  template <typename A>
+  auto operator()(const A& a) const
+      -> decltype(std::declval<const F2&>()(std::declval<const F1&>()(a))) {
+    return second(first(a));
+  }
+
+  F1 first;
+  F2 second;
+};
+
+// The base of the expressions built using placeholders (see fn/expr.h).
+struct ExprBase {};
+
+template <typename T>
+struct is_expression {
+  static const bool value = std::is_base_of<ExprBase, T>::value;
+};
+
+// Returns the conjunction of two predicates. Conjunctions of expressions are
+// expressions themselves (see fn/expr.h).
+template <typename F1, typename F2,
+          typename std::enable_if<!is_expression<F1>::value ||
+                                      !is_expression<F2>::value,
+                                  int>::type = 0>
+Conjunction<F1, F2> conjoin(const F1& f1, const F2& f2) {
+  return Conjunction<F1, F2>(f1, f2);
+}
+
+// Returns the composition of two functions. Compositions of expressions are
+// expressions themselves (see fn/expr.h).
+template <typename F1, typename F2,
+          typename std::enable_if<!is_expression<F1>::value ||
+                                      !is_expression<F2>::value,
+                                  int>::type = 0>
+Composition<F1, F2> compose(const F1& f1, const F2& f2) {
+  return Composition<F1, F2>(f1, f2);
+}
+
+template <typename F1, typename F2>
+struct Conjoined {
+  using type = decltype(conjoin(std::declval<const F1&>(),
+                                std::declval<const F2&>()));
+};
+
+template <typename F1, typename F2>
+struct Composed {
+  using type = decltype(compose(std::declval<const F1&>(),
+                                std::declval<const F2&>()));
+};
+
+// The function of a MAP_FILTER stage: elements are mapped using map and then
+// filtered using pred.
+template <typename M, typename F>
+struct MapFilter {
+  using Map = M;
+  using Pred = F;
+
+  MapFilter(const M& m, const F& f) : map(m), pred(f) {}
+
+  M map;
+  F pred;
+};
+
+// A predicate that holds for values in [lo, hi]. On sliceable views, range
+// filters are evaluated using a binary search instead of a scan.
+template <typename T>
+struct Between {
+  Between(const T& l, const T& h) : lo(l), hi(h) {}
+
+  template <typename A>
+  bool operator()(const A& a) const {
+    return !(a < lo) && !(hi < a);
+  }
+
+  T lo;
+  T hi;
+};
+
+template <typename>
+struct is_range_filter {
+  static const bool value = false;
+};
+
+template <typename T>
+struct is_range_filter<Between<T>> {
+  static const bool value = true;
+};
+
+// Whether filtering V using G gets a stage of its own even when V is a filter.
+// Range filters on sliceable views are kept apart from other predicates, so
+// that they can still be evaluated by a binary search.
+template <typename V, typename G>
+struct is_slice_filter {
+  static const bool value =
+      V::sliceable && (is_range_filter<typename V::Func>::value ||
+                       is_range_filter<G>::value);
+};
+
+// The type of the view created by filtering V using G. A filter applied on a
+// filter is fused into one conjunctive stage, and a filter applied on a map is
+// fused into one map-filter stage. Everything else, including filtering a root
+// view or any view marked fresh, gets a new stage.
+template <typename V, typename G, FuncType ftype, bool fresh>
+struct FilterFusion {
+  using type =
+      typename V::template Rebind<typename V::Element, V, G, FuncType::FILTER>;
+};
+
+template <typename V, typename G>
+struct FilterFusion<V, G, FuncType::FILTER, false> {
+  using type = typename V::template Rebind<
+      typename V::Element, typename V::PView,
+      typename Conjoined<typename V::Func, G>::type, FuncType::FILTER>;
+};
+
+template <typename V, typename G>
+struct FilterFusion<V, G, FuncType::MAP, false> {
+  using type = typename V::template Rebind<
+      typename V::Element, typename V::PView, MapFilter<typename V::Func, G>,
+      FuncType::MAP_FILTER>;
+};
+
+template <typename V, typename G>
+struct FilterFusion<V, G, FuncType::MAP_FILTER, false> {
+  using type = typename V::template Rebind<
+      typename V::Element, typename V::PView,
+      MapFilter<typename V::Func::Map,
+                typename Conjoined<typename V::Func::Pred, G>::type>,
+      FuncType::MAP_FILTER>;
+};
+
+// The type of the view created by mapping V to elements of type E using G. A
+// map applied on a map is fused into one stage composing both functions.
+template <typename V, typename E, typename G, FuncType ftype, bool root>
+struct MapFusion {
+  using type = typename V::template Rebind<E, V, G, FuncType::MAP>;
+};
+
+template <typename V, typename E, typename G>
+struct MapFusion<V, E, G, FuncType::MAP, false> {
+  using type =
+      typename V::template Rebind<E, typename V::PView,
+                                  typename Composed<typename V::Func, G>::type,
+                                  FuncType::MAP>;
+};
+
+// Appends e to c, using push_back for sequences and insert for sets.
+template <typename C, typename E>
+auto append(C* c, const E& e) -> decltype(c->push_back(e), void()) {
+  c->push_back(e);
+}
+
+template <typename C, typename E>
+auto append(C* c, const E& e) -> decltype(c->insert(e), void()) {
+  c->insert(e);
+}
+
+// Sorts c using cmp, using the member sort of lists and std::sort otherwise.
+template <typename C, typename Cmp>
+auto sort(C* c, Cmp cmp) -> decltype(c->sort(cmp), void()) {
+  c->sort(cmp);
+}
+
+template <typename C, typename Cmp>
+auto sort(C* c, Cmp cmp) -> typename std::enable_if<
+    std::is_same<std::random_access_iterator_tag,
+                 typename std::iterator_traits<decltype(
+                     c->begin())>::iterator_category>::value>::type {
+  std::sort(c->begin(), c->end(), cmp);
+}
+
+// The element type of the inner collections returned by the function of a
+// flat_map. Inner collections can be containers, views or pairs of iterators.
+template <typename I>
+struct inner_element {
+  using type = typename I::value_type;
+};
+
+template <typename It>
+struct inner_element<std::pair<It, It>> {
+  using type = typename std::iterator_traits<It>::value_type;
+};
+
+template <typename I>
+auto inner_begin(const I& i) -> decltype(i.begin()) {
+  return i.begin();
+}
+
+template <typename I>
+auto inner_end(const I& i) -> decltype(i.end()) {
+  return i.end();
+}
+
+template <typename It>
+It inner_begin(const std::pair<It, It>& i) {
+  return i.first;
+}
+
+template <typename It>
+It inner_end(const std::pair<It, It>& i) {
+  return i.second;
+}
+
+// Whether an inner collection may refer to the outer element it was computed
+// from, instead of holding its elements: iterator pairs and views (which have
+// a CPtr) do, while containers are copied along with their elements.
+template <typename I, typename = void>
+struct inner_refers {
+  static const bool value = false;
+};
+
+template <typename It>
+struct inner_refers<std::pair<It, It>> {
+  static const bool value = true;
+};
+
+template <typename I>
+struct inner_refers<
+    I, typename std::conditional<true, void, typename I::CPtr>::type> {
+  static const bool value = true;
+};
+
+// Returns the iterator of to at the position of that_iter in that, which is
+// constant time for random access iterators.
+template <typename I, typename It>
+It inner_at(const I& to, const I& that, It that_iter) {
+  auto iter = inner_begin(to);
+  std::advance(iter, std::distance(inner_begin(that), that_iter));
+  return iter;
+}
+
+// Copies of iterator pairs iterate over the same elements, so their iterators
+// are copied as they are.
+template <typename It>
+It inner_at(const std::pair<It, It>& /* to */,
+            const std::pair<It, It>& /* that */, It that_iter) {
+  return that_iter;
+}
+
+// Holds the inner collection of a flat_map and the iterators on it. If the
+// parent iterator produces temporaries, the outer element is kept alongside,
+// since the inner collection may refer to it. Copies copy the inner collection,
+// except when it may refer to the kept outer element (see inner_refers): then
+// it is computed again by calling the function on the copy of the outer
+// element.
+template <typename O, typename I, bool keep = !std::is_reference<O>::value>
+struct InnerSlot {
+  using Iter = decltype(inner_begin(std::declval<const I&>()));
+
+  template <typename It, typename F>
+  InnerSlot(const It& it, const F& f)
+      : inner(f(*it)), iter(inner_begin(inner)), end(inner_end(inner)) {}
+
+  // Copies the slot of another iterator, at the same position.
+  template <typename F>
+  InnerSlot(const InnerSlot& that, const F& /* f */)
+      : inner(that.inner),
+        iter(inner_at(inner, that.inner, that.iter)),
+        end(inner_end(inner)) {}
+
+  I inner;
+  Iter iter;
+  Iter end;
+};
+
+template <typename O, typename I>
+struct InnerSlot<O, I, true> {
+  using Iter = decltype(inner_begin(std::declval<const I&>()));
+
+  template <typename It, typename F>
+  InnerSlot(const It& it, const F& f)
+      : outer(*it),
+        inner(f(outer)),
+        iter(inner_begin(inner)),
+        end(inner_end(inner)) {}
+
+  // Copies the slot of another iterator, at the same position.
+  template <typename F>
+  InnerSlot(const InnerSlot& that, const F& f)
+      : InnerSlot(that, f,
+                  std::integral_constant<bool, inner_refers<I>::value>()) {}
+
+  typename std::decay<O>::type outer;
+  I inner;
+  Iter iter;
+  Iter end;
+
+ private:
+  template <typename F>
+  InnerSlot(const InnerSlot& that, const F& /* f */, std::false_type)
+      : outer(that.outer),
+        inner(that.inner),
+        iter(inner_at(inner, that.inner, that.iter)),
+        end(inner_end(inner)) {}
+
+  // The inner collection of that may refer to that.outer, so it is computed
+  // again from the copy, and only positions are carried over.
+  template <typename F>
+  InnerSlot(const InnerSlot& that, const F& f, std::true_type)
+      : outer(that.outer),
+        inner(f(outer)),
+        iter(inner_begin(inner)),
+        end(inner_end(inner)) {
+    std::advance(iter, std::distance(inner_begin(that.inner), that.iter));
+  }
+};
+
 template <typename View, typename PView = typename View::PView,
           FuncType ftype = View::func_type>
 class ViewIterator;
@@ -194,6 +653,72 @@ class ViewIterator<
   ViewIterator<PView> iter_;
 };
 
+template <typename View, typename PView>
+class ViewIterator<
+    View, PView,
+    FuncType::MAP_FILTER> : public std::iterator<std::forward_iterator_tag,
+                                                 typename View::Element> {
+ public:
+  using Element = typename View::Element;
+
+  explicit ViewIterator(const View* view)
+      : ViewIterator(view, ViewIterator<PView>(&view->parent_)) {}
+
+  ViewIterator(const View* view, ViewIterator<PView>&& iter)
+      : view_(view), iter_(std::move(iter)) {
+    move_while_filtered();
+  }
+
+  ViewIterator& operator++() {
+    if (is_at_end()) {
+      return *this;
+    }
+
+    ++iter_;
+    move_while_filtered();
+
+    return *this;
+  }
+
+  ViewIterator operator++(int) {
+    auto cp = *this;
+    ++*this;
+    return cp;
+  }
+
+  const Element& operator*() const { return value_; }
+  const Element* operator->() const { return &value_; }
+
+  bool operator==(const ViewIterator& that) const {
+    return iter_ == that.iter_ && view_ == that.view_;
+  }
+
+  bool operator!=(const ViewIterator& that) const {
+    return iter_ != that.iter_ || view_ != that.view_;
+  }
+
+  bool is_at_end() { return iter_.is_at_end(); }
+
+ private:
+  void move_to_end() { iter_.move_to_end(); }
+
+  // Maps the current element, and moves forward until the mapped value passes
+  // the filter. The mapped value is cached for operator*.
+  void move_while_filtered() {
+    while (!is_at_end()) {
+      value_ = view_->func_.map(*iter_);
+      if (view_->func_.pred(value_)) {
+        return;
+      }
+      ++iter_;
+    }
+  }
+
+  const View* view_;
+  ViewIterator<PView> iter_;
+  Element value_;
+};
+
 template <typename View, typename PView>
 class ViewIterator<View, PView, FuncType::SKIP> : public std::iterator<
                                                       std::forward_iterator_tag,
@@ -243,7 +768,7 @@ class ViewIterator<View, PView, FuncType::SKIP> : public std::iterator<
   void move_to_begin() { move_while_skipped(); }
 
   void move_while_skipped() {
-    while (!is_at_end() && view_->func_(*iter_)) {
+    while (!is_at_end() && !view_->func_(*iter_)) {
       ++iter_;
     }
   }
@@ -257,6 +782,11 @@ class ViewIterator<
     View, PView,
     FuncType::FLAT_MAP> : public std::iterator<std::forward_iterator_tag,
                                                typename View::Element> {
+  using Outer = decltype(*std::declval<const ViewIterator<PView>&>());
+  using Inner = typename std::decay<decltype(
+      std::declval<const View&>().func_(std::declval<Outer>()))>::type;
+  using Slot = InnerSlot<Outer, Inner>;
+
  public:
   using Element = typename View::Element;
 
@@ -264,69 +794,130 @@ class ViewIterator<
       : ViewIterator(view, ViewIterator<PView>(&view->parent_)) {}
 
   ViewIterator(const View* view, ViewIterator<PView>&& iter)
-      : view_(view), iter_(std::move(iter)) {
-    move_to_begin();
+      : view_(view),
+        iter_(std::move(iter)),
+        slot_(),
+        pos_(0),
+        loaded_(false) {
+    move_to_nonempty_inner();
+  }
+
+  // The inner collection lives in the iterator and the inner iterators point
+  // into it. So, the slot is copied with its iterators moved to the copy.
+  ViewIterator(const ViewIterator& that)
+      : view_(that.view_),
+        iter_(that.iter_),
+        slot_(),
+        pos_(0),
+        loaded_(false) {
+    copy_slot(that);
+  }
+
+  ViewIterator& operator=(const ViewIterator& that) {
+    if (this != &that) {
+      view_ = that.view_;
+      iter_ = that.iter_;
+      copy_slot(that);
+    }
+    return *this;
   }
 
+  ~ViewIterator() { unload(); }
+
   ViewIterator& operator++() {
     if (is_at_end()) {
       return *this;
     }
 
-    assert(citer_ != cend_ &&
+    assert(slot().iter != slot().end &&
            "Container iterator is at end but the parent iterator is not "
            "not at its end.");
 
-    citer_++;
-    if (citer_ == cend_) {
-      move_to_nonempty_map();
+    ++slot().iter;
+    ++pos_;
+    if (slot().iter == slot().end) {
+      ++iter_;
+      move_to_nonempty_inner();
     }
     return *this;
   }
 
-  ViewIterator& operator++(int) {
+  ViewIterator operator++(int) {
     auto cp = *this;
     ++*this;
     return cp;
   }
 
-  const Element& operator*() const { return *citer_; }
-  const Element& operator->() const { return citer_.operator->(); }
+  auto operator*() const
+      -> decltype(*std::declval<const typename Slot::Iter&>()) {
+    return *slot().iter;
+  }
 
   bool operator==(const ViewIterator& that) const {
-    return iter_ == that.iter_ && view_ == that.view_;
+    return iter_ == that.iter_ && pos_ == that.pos_ && view_ == that.view_;
   }
 
-  bool operator!=(const ViewIterator& that) const {
-    return iter_ != that.iter_ || view_ != that.view_;
-  }
+  bool operator!=(const ViewIterator& that) const { return !(*this == that); }
 
   bool is_at_end() { return iter_.is_at_end(); }
 
  private:
-  void move_to_end() { iter_.move_to_end(); }
-
-  void move_to_begin() { move_to_nonempty_map(); }
+  void move_to_end() {
+    iter_.move_to_end();
+    unload();
+  }
 
-  void move_to_nonempty_map() {
-    do {
-      cntr_ = std::move(view_->func_(*iter_));
-      citer_ = cntr_.begin();
-      cend_ = cntr_.end();
+  void move_to_nonempty_inner() {
+    while (!is_at_end()) {
+      load();
+      if (slot().iter != slot().end) {
+        return;
+      }
       ++iter_;
-    } while (!is_at_end() && citer_ == cend_);
+    }
+    unload();
+  }
+
+  void copy_slot(const ViewIterator& that) {
+    unload();
+    if (!that.loaded_) {
+      return;
+    }
+
+    new (&slot_) Slot(that.slot(), view_->func_);
+    loaded_ = true;
+    pos_ = that.pos_;
+  }
+
+  // Computes the inner collection of the current outer element. The same slot
+  // is reused for every outer element, so this never allocates by itself.
+  void load() {
+    unload();
+    new (&slot_) Slot(iter_, view_->func_);
+    loaded_ = true;
+  }
+
+  void unload() {
+    pos_ = 0;
+    if (!loaded_) {
+      return;
+    }
+
+    slot().~Slot();
+    loaded_ = false;
   }
 
+  Slot& slot() { return *reinterpret_cast<Slot*>(&slot_); }
+  const Slot& slot() const { return *reinterpret_cast<const Slot*>(&slot_); }
+
   const View* view_;
   ViewIterator<PView> iter_;
 
-  using PElem = typename PView::Element;
-  using Container = decltype(view_->g(*(PElem*) nullptr));
-  using CIter = typename Container::const_iterator;
-
-  Container cntr_;
-  CIter citer_;
-  CIter cend_;
+  // Holds a Slot while loaded_. It is zeroed on construction, so that the
+  // compiler sees no path reading it uninitialized.
+  typename std::aligned_storage<sizeof(Slot), alignof(Slot)>::type slot_;
+  size_t pos_;
+  bool loaded_;
 };
 
 template <typename View, typename PView>
@@ -389,6 +980,63 @@ class ViewIterator<View, PView, FuncType::KEEP> : public std::iterator<
   ViewIterator<PView> iter_;
 };
 
+template <typename View, typename PView>
+class ViewIterator<View, PView, FuncType::PROBE>
+    : public std::iterator<std::forward_iterator_tag, typename View::Element> {
+ public:
+  using Element = typename View::Element;
+
+  explicit ViewIterator(const View* view)
+      : ViewIterator(view, ViewIterator<PView>(&view->parent_)) {}
+
+  ViewIterator(const View* view, ViewIterator<PView>&& iter)
+      : view_(view), iter_(std::move(iter)) {}
+
+  ViewIterator& operator++() {
+    if (is_at_end()) {
+      return *this;
+    }
+
+    view_->func_.count();
+    ++iter_;
+    return *this;
+  }
+
+  ViewIterator operator++(int) {
+    auto cp = *this;
+    ++*this;
+    return cp;
+  }
+
+  // Pass the elements through as the parent iterator yields them, by value or
+  // by reference.
+  auto operator*() const
+      -> decltype(*std::declval<const ViewIterator<PView>&>()) {
+    return *iter_;
+  }
+
+  auto operator->() const
+      -> decltype(std::declval<const ViewIterator<PView>&>().operator->()) {
+    return iter_.operator->();
+  }
+
+  bool operator==(const ViewIterator& that) const {
+    return iter_ == that.iter_ && view_ == that.view_;
+  }
+
+  bool operator!=(const ViewIterator& that) const {
+    return iter_ != that.iter_ || view_ != that.view_;
+  }
+
+  bool is_at_end() { return iter_.is_at_end(); }
+
+ private:
+  void move_to_end() { iter_.move_to_end(); }
+
+  const View* view_;
+  ViewIterator<PView> iter_;
+};
+
 template <typename View, typename PView1, typename PView2>
 class ViewIterator<
     View, std::pair<PView1, PView2>,
@@ -0,0 +1,149 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_EXPLAIN_H_
+#define FUNC_EXPLAIN_H_
+
+#include <cstddef>
+#include <cstdlib>
+
+#include <algorithm>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+#include "fn/details.h"
+
+namespace fn {
+namespace details {
+
+// An estimate of the number of elements of a view, for View::explain(). Exact
+// estimates are known sizes, and others are upper bounds.
+struct Estimate {
+  static const size_t kUnknown = static_cast<size_t>(-1);
+
+  size_t rows;
+  bool exact;
+
+  std::string to_string() const {
+    if (rows == kUnknown) {
+      return "rows unknown";
+    }
+
+    return (exact ? "rows = " : "rows <= ") + std::to_string(rows);
+  }
+};
+
+// The number of elements of a root container, unknown for streams without a
+// size.
+template <typename C>
+auto estimate_root(const C& c, int) -> decltype(c.size(), Estimate()) {
+  return Estimate{c.size(), true};
+}
+
+template <typename C>
+Estimate estimate_root(const C& /* c */, long) {
+  return Estimate{Estimate::kUnknown, false};
+}
+
+// Estimates the number of elements produced by a stage receiving in.
+inline Estimate estimate(FuncType t, const Estimate& in) {
+  switch (t) {
+    case FuncType::FILTER:
+    case FuncType::KEEP:
+    case FuncType::MAP_FILTER:
+    case FuncType::SKIP:
+      return Estimate{in.rows, false};
+    case FuncType::FLAT_MAP:
+      return Estimate{Estimate::kUnknown, false};
+    default:
+      return in;
+  }
+}
+
+// Zips produce as many elements as their shortest side.
+inline Estimate estimate_zip(const Estimate& first, const Estimate& second) {
+  return Estimate{std::min(first.rows, second.rows),
+                  first.exact && second.exact};
+}
+
+// The name of an ownership policy.
+template <template <typename...> class R>
+struct policy_name {
+  static const char* value() { return "custom"; }
+};
+
+template <>
+struct policy_name<Copy> {
+  static const char* value() { return "Copy"; }
+};
+
+template <>
+struct policy_name<Ref> {
+  static const char* value() { return "Ref"; }
+};
+
+template <>
+struct policy_name<SortedCopy> {
+  static const char* value() { return "SortedCopy"; }
+};
+
+template <>
+struct policy_name<SortedRef> {
+  static const char* value() { return "SortedRef"; }
+};
+
+// Whether copying a root with the policy R<T> copies its container on the
+// heap.
+template <template <typename...> class R, typename T>
+struct is_heap_copy {
+  static const bool value = false;
+};
+
+template <typename T>
+struct is_heap_copy<Copy, T> {
+  static const bool value = !(sizeof(T) <= kInlineCopySize &&
+                              std::is_trivially_copyable<T>::value);
+};
+
+template <typename T>
+struct is_heap_copy<SortedCopy, T> {
+  static const bool value = is_heap_copy<Copy, T>::value;
+};
+
+// The readable name of T, demangled when possible.
+template <typename T>
+std::string type_name() {
+#if defined(__GNUG__)
+  int status = 0;
+  char* name =
+      abi::__cxa_demangle(typeid(T).name(), nullptr, nullptr, &status);
+  if (status == 0 && name != nullptr) {
+    std::string demangled(name);
+    free(name);
+    return demangled;
+  }
+#endif
+
+  return typeid(T).name();
+}
+
+}  // namespace details
+}  // namespace fn
+
+#endif  // FUNC_EXPLAIN_H_
@@ -0,0 +1,477 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_EXPR_H_
+#define FUNC_EXPR_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "fn/details.h"
+
+namespace fn {
+namespace details {
+
+// Expressions are function objects built from placeholders, constants and
+// operators, such as _1 % 3 == 0 || _1 % 5 == 0. Unlike lambdas they are not
+// opaque: views recognize them and evaluate them in batches on contiguous
+// roots, without branching per element.
+//
+// Each expression provides eval(), which has the usual C++ semantics (e.g., &&
+// short-circuits), and eval_nb(), which evaluates all operands and combines
+// logical operators bitwise. eval_nb() is only used when safe() holds, ie,
+// when evaluating all operands cannot divide by zero.
+template <typename D>
+struct Expr : ExprBase {
+  template <typename DD = D, typename... A>
+  auto operator()(const A&... a) const
+      -> decltype(std::declval<const DD&>().eval(a...)) {
+    return static_cast<const D&>(*this).eval(a...);
+  }
+};
+
+// The I-th argument of the expression.
+template <size_t I>
+struct Arg : Expr<Arg<I>> {
+  template <typename... A>
+  auto eval(const A&... a) const
+      -> decltype(std::get<I>(std::tie(a...))) {
+    return std::get<I>(std::tie(a...));
+  }
+
+  template <typename... A>
+  auto eval_nb(const A&... a) const
+      -> decltype(std::get<I>(std::tie(a...))) {
+    return std::get<I>(std::tie(a...));
+  }
+
+  bool safe() const { return true; }
+};
+
+template <typename T>
+struct Const : Expr<Const<T>> {
+  explicit Const(const T& v) : value(v) {}
+
+  template <typename... A>
+  const T& eval(const A&...) const {
+    return value;
+  }
+
+  template <typename... A>
+  const T& eval_nb(const A&...) const {
+    return value;
+  }
+
+  bool safe() const { return true; }
+
+  T value;
+};
+
+// Whether a / b and a % b are on integers of at most 32 bits. eval_nb() then
+// computes them in double precision, which unlike integer division by a
+// divisor only known at run time is vectorized on common targets.
+template <typename A, typename B>
+struct is_narrow_division {
+  static const bool value = std::is_integral<A>::value &&
+                            std::is_integral<B>::value && sizeof(A) <= 4 &&
+                            sizeof(B) <= 4;
+};
+
+// Returns x / y for integers of at most 32 bits by multiplying by the
+// reciprocal of y in double precision. The product is only inexact enough to
+// matter when the quotient is an integer, where it may truncate one short of
+// it; the remainder detects that case.
+template <typename T>
+T narrow_quotient(T x, T y) {
+  T q = static_cast<T>(static_cast<double>(x) * (1 / static_cast<double>(y)));
+  T r = x - q * y;
+  return static_cast<T>(q + (r == y) -
+                        (std::is_signed<T>::value && r == T(-y)));
+}
+
+// Operators are defined using the OP structs below. Division and modulo are
+// safe only for non-zero constant divisors. apply_nb() is used by eval_nb().
+#define FN_EXPR_OP(Name, op)                                                 \
+  struct Name {                                                              \
+    template <typename A, typename B>                                        \
+    static auto apply(const A& a, const B& b) -> decltype(a op b) {          \
+      return a op b;                                                         \
+    }                                                                        \
+                                                                             \
+    template <typename A, typename B>                                        \
+    static auto apply_nb(const A& a, const B& b) -> decltype(a op b) {       \
+      return a op b;                                                         \
+    }                                                                        \
+                                                                             \
+    template <typename R>                                                    \
+    static bool safe_divisor(const R&) {                                     \
+      return true;                                                           \
+    }                                                                        \
+  };
+
+#define FN_EXPR_DIV_OP(Name, op, narrow)                                     \
+  struct Name {                                                              \
+    template <typename A, typename B>                                        \
+    static auto apply(const A& a, const B& b) -> decltype(a op b) {          \
+      return a op b;                                                         \
+    }                                                                        \
+                                                                             \
+    template <typename A, typename B,                                        \
+              typename std::enable_if<!is_narrow_division<A, B>::value,      \
+                                      int>::type = 0>                        \
+    static auto apply_nb(const A& a, const B& b) -> decltype(a op b) {       \
+      return a op b;                                                         \
+    }                                                                        \
+                                                                             \
+    template <typename A, typename B,                                        \
+              typename std::enable_if<is_narrow_division<A, B>::value,       \
+                                      int>::type = 0>                        \
+    static auto apply_nb(const A& a, const B& b) -> decltype(a op b) {       \
+      typedef decltype(a op b) T;                                            \
+      T x = static_cast<T>(a), y = static_cast<T>(b);                        \
+      T q = narrow_quotient(x, y);                                           \
+      return narrow;                                                         \
+    }                                                                        \
+                                                                             \
+    template <typename R>                                                    \
+    static bool safe_divisor(const R&) {                                     \
+      return false;                                                          \
+    }                                                                        \
+                                                                             \
+    template <typename T>                                                    \
+    static bool safe_divisor(const Const<T>& c) {                            \
+      return c.value != T();                                                 \
+    }                                                                        \
+  };
+
+FN_EXPR_OP(AddOp, +)
+FN_EXPR_OP(SubOp, -)
+FN_EXPR_OP(MulOp, *)
+FN_EXPR_DIV_OP(DivOp, /, q)
+FN_EXPR_DIV_OP(ModOp, %, x - q * y)
+FN_EXPR_OP(EqOp, ==)
+FN_EXPR_OP(NeOp, !=)
+FN_EXPR_OP(LtOp, <)
+FN_EXPR_OP(LeOp, <=)
+FN_EXPR_OP(GtOp, >)
+FN_EXPR_OP(GeOp, >=)
+FN_EXPR_OP(BitAndOp, &)
+FN_EXPR_OP(BitOrOp, |)
+FN_EXPR_OP(BitXorOp, ^)
+
+#undef FN_EXPR_OP
+#undef FN_EXPR_DIV_OP
+
+struct AndOp {};
+struct OrOp {};
+
+template <typename Op, typename L, typename R>
+struct Binary : Expr<Binary<Op, L, R>> {
+  Binary(const L& l, const R& r) : left(l), right(r) {}
+
+  template <typename... A>
+  auto eval(const A&... a) const
+      -> decltype(Op::apply(std::declval<const L&>().eval(a...),
+                            std::declval<const R&>().eval(a...))) {
+    return Op::apply(left.eval(a...), right.eval(a...));
+  }
+
+  template <typename... A>
+  auto eval_nb(const A&... a) const
+      -> decltype(Op::apply_nb(std::declval<const L&>().eval_nb(a...),
+                               std::declval<const R&>().eval_nb(a...))) {
+    return Op::apply_nb(left.eval_nb(a...), right.eval_nb(a...));
+  }
+
+  bool safe() const {
+    return Op::safe_divisor(right) && left.safe() && right.safe();
+  }
+
+  L left;
+  R right;
+};
+
+template <typename L, typename R>
+struct Binary<AndOp, L, R> : Expr<Binary<AndOp, L, R>> {
+  Binary(const L& l, const R& r) : left(l), right(r) {}
+
+  template <typename... A>
+  bool eval(const A&... a) const {
+    return left.eval(a...) && right.eval(a...);
+  }
+
+  template <typename... A>
+  bool eval_nb(const A&... a) const {
+    return static_cast<bool>(left.eval_nb(a...)) &
+           static_cast<bool>(right.eval_nb(a...));
+  }
+
+  bool safe() const { return left.safe() && right.safe(); }
+
+  L left;
+  R right;
+};
+
+template <typename L, typename R>
+struct Binary<OrOp, L, R> : Expr<Binary<OrOp, L, R>> {
+  Binary(const L& l, const R& r) : left(l), right(r) {}
+
+  template <typename... A>
+  bool eval(const A&... a) const {
+    return left.eval(a...) || right.eval(a...);
+  }
+
+  template <typename... A>
+  bool eval_nb(const A&... a) const {
+    return static_cast<bool>(left.eval_nb(a...)) |
+           static_cast<bool>(right.eval_nb(a...));
+  }
+
+  bool safe() const { return left.safe() && right.safe(); }
+
+  L left;
+  R right;
+};
+
+struct NegOp {
+  template <typename A>
+  static auto apply(const A& a) -> decltype(-a) {
+    return -a;
+  }
+};
+
+struct NotOp {
+  template <typename A>
+  static bool apply(const A& a) {
+    return !a;
+  }
+};
+
+template <typename Op, typename E>
+struct Unary : Expr<Unary<Op, E>> {
+  explicit Unary(const E& e) : operand(e) {}
+
+  template <typename... A>
+  auto eval(const A&... a) const
+      -> decltype(Op::apply(std::declval<const E&>().eval(a...))) {
+    return Op::apply(operand.eval(a...));
+  }
+
+  template <typename... A>
+  auto eval_nb(const A&... a) const
+      -> decltype(Op::apply(std::declval<const E&>().eval_nb(a...))) {
+    return Op::apply(operand.eval_nb(a...));
+  }
+
+  bool safe() const { return operand.safe(); }
+
+  E operand;
+};
+
+// Applies first and then second, where both are unary expressions. Adjacent
+// maps of expressions are fused using this expression.
+template <typename F1, typename F2>
+struct Compose : Expr<Compose<F1, F2>> {
+  Compose(const F1& f1, const F2& f2) : first(f1), second(f2) {}
+
+  template <typename A>
+  auto eval(const A& a) const
+      -> decltype(std::declval<const F2&>().eval(
+          std::declval<const F1&>().eval(a))) {
+    return second.eval(first.eval(a));
+  }
+
+  template <typename A>
+  auto eval_nb(const A& a) const
+      -> decltype(std::declval<const F2&>().eval_nb(
+          std::declval<const F1&>().eval_nb(a))) {
+    return second.eval_nb(first.eval_nb(a));
+  }
+
+  bool safe() const { return first.safe() && second.safe(); }
+
+  F1 first;
+  F2 second;
+};
+
+template <typename L, typename R,
+          typename std::enable_if<is_expression<L>::value &&
+                                      is_expression<R>::value,
+                                  int>::type = 0>
+Binary<AndOp, L, R> conjoin(const L& l, const R& r) {
+  return Binary<AndOp, L, R>(l, r);
+}
+
+template <typename F1, typename F2,
+          typename std::enable_if<is_expression<F1>::value &&
+                                      is_expression<F2>::value,
+                                  int>::type = 0>
+Compose<F1, F2> compose(const F1& f1, const F2& f2) {
+  return Compose<F1, F2>(f1, f2);
+}
+
+// Operands of expression operators are expressions or arithmetic constants,
+// and at least one of them should be an expression.
+template <typename T>
+struct as_expr {
+  using type = typename std::conditional<is_expression<T>::value, T,
+                                         Const<T>>::type;
+
+  static type wrap(const T& t) { return type(t); }
+};
+
+template <typename L, typename R>
+struct is_operand {
+  static const bool value =
+      (is_expression<L>::value || is_expression<R>::value) &&
+      (is_expression<L>::value || std::is_arithmetic<L>::value) &&
+      (is_expression<R>::value || std::is_arithmetic<R>::value);
+};
+
+#define FN_EXPR_BINARY_OPERATOR(op, Op)                                   \
+  template <typename L, typename R,                                       \
+            typename std::enable_if<is_operand<L, R>::value, int>::type = \
+                0>                                                        \
+  Binary<Op, typename as_expr<L>::type, typename as_expr<R>::type>        \
+  operator op(const L& l, const R& r) {                                   \
+    return Binary<Op, typename as_expr<L>::type,                          \
+                  typename as_expr<R>::type>(as_expr<L>::wrap(l),         \
+                                             as_expr<R>::wrap(r));        \
+  }
+
+FN_EXPR_BINARY_OPERATOR(+, AddOp)
+FN_EXPR_BINARY_OPERATOR(-, SubOp)
+FN_EXPR_BINARY_OPERATOR(*, MulOp)
+FN_EXPR_BINARY_OPERATOR(/, DivOp)
+FN_EXPR_BINARY_OPERATOR(%, ModOp)
+FN_EXPR_BINARY_OPERATOR(==, EqOp)
+FN_EXPR_BINARY_OPERATOR(!=, NeOp)
+FN_EXPR_BINARY_OPERATOR(<, LtOp)
+FN_EXPR_BINARY_OPERATOR(<=, LeOp)
+FN_EXPR_BINARY_OPERATOR(>, GtOp)
+FN_EXPR_BINARY_OPERATOR(>=, GeOp)
+FN_EXPR_BINARY_OPERATOR(&, BitAndOp)
+FN_EXPR_BINARY_OPERATOR(|, BitOrOp)
+FN_EXPR_BINARY_OPERATOR(^, BitXorOp)
+FN_EXPR_BINARY_OPERATOR(&&, AndOp)
+FN_EXPR_BINARY_OPERATOR(||, OrOp)
+
+#undef FN_EXPR_BINARY_OPERATOR
+
+template <typename E, typename std::enable_if<is_expression<E>::value,
+                                              int>::type = 0>
+Unary<NegOp, E> operator-(const E& e) {
+  return Unary<NegOp, E>(e);
+}
+
+template <typename E, typename std::enable_if<is_expression<E>::value,
+                                              int>::type = 0>
+Unary<NotOp, E> operator!(const E& e) {
+  return Unary<NotOp, E>(e);
+}
+
+// Whether a stage with function F on parent P can be evaluated in batches: F
+// is an expression and P is a root view on a contiguous container of
+// arithmetic elements.
+template <typename P, typename F, typename = void>
+struct is_batched_stage {
+  static const bool value = false;
+};
+
+template <typename P, typename F>
+struct is_batched_stage<
+    P, F, typename std::enable_if<
+              is_expression<F>::value &&
+              std::is_same<void*, typename P::PView>::value &&
+              std::is_arithmetic<typename P::Element>::value &&
+              std::is_pointer<decltype(std::declval<
+                                       const typename P::Container&>()
+                                       .data())>::value>::type> {
+  static const bool value = true;
+};
+
+// Number of elements evaluated in each batch.
+const size_t kBatchSize = 256;
+
+// Calls g for the elements of [data, data + n) that satisfy pred. The predicate
+// is evaluated for a batch of elements into a mask without branches, and then
+// the selected elements are compacted into a selection vector.
+template <typename T, typename Pred, typename G>
+void filter_batched(const T* data, size_t n, const Pred& pred, G& g) {
+  uint8_t mask[kBatchSize];
+  uint16_t sel[kBatchSize];
+
+  for (size_t b = 0; b < n; b += kBatchSize) {
+    auto batch = data + b;
+    auto m = std::min(kBatchSize, n - b);
+
+    for (size_t i = 0; i < m; i++) {
+      mask[i] = static_cast<bool>(pred.eval_nb(batch[i]));
+    }
+
+    size_t k = 0;
+    for (size_t i = 0; i < m; i++) {
+      sel[k] = static_cast<uint16_t>(i);
+      k += mask[i];
+    }
+
+    for (size_t i = 0; i < k; i++) {
+      g(batch[sel[i]]);
+    }
+  }
+}
+
+// Calls g for f(e) for the elements of [data, data + n). f is evaluated for a
+// batch of elements at a time.
+template <typename T, typename F, typename G>
+void map_batched(const T* data, size_t n, const F& f, G& g) {
+  using U = typename std::decay<decltype(f.eval_nb(*data))>::type;
+  U out[kBatchSize];
+
+  for (size_t b = 0; b < n; b += kBatchSize) {
+    auto batch = data + b;
+    auto m = std::min(kBatchSize, n - b);
+
+    for (size_t i = 0; i < m; i++) {
+      out[i] = f.eval_nb(batch[i]);
+    }
+
+    for (size_t i = 0; i < m; i++) {
+      g(out[i]);
+    }
+  }
+}
+
+}  // namespace details
+
+// Placeholders for building expressions:
+//
+//   using namespace fn::placeholders;
+//   auto fizzbuzz = _(&v).filter(_1 % 3 == 0 || _1 % 5 == 0);
+//   auto odds = _(&v).map(_1 * 2 + 1);
+//   auto sum = _(&v).reduce(_1 + _2);
+namespace placeholders {
+
+const details::Arg<0> _1 = details::Arg<0>();
+const details::Arg<1> _2 = details::Arg<1>();
+
+}  // namespace placeholders
+}  // namespace fn
+
+#endif  // FUNC_EXPR_H_
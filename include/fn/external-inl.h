@@ -0,0 +1,360 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_EXTERNAL_INL_H_
+#define FUNC_EXTERNAL_INL_H_
+
+#include <cerrno>
+#include <cstdlib>
+
+#include <algorithm>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace fn {
+namespace details {
+
+// The memory used by each entry of a hash map beyond its key and value.
+const size_t kHashEntryOverhead = 32;
+
+// Partitions of keys spilled with this seed are reduced in memory however many
+// entries they have, since keys whose hashes collide cannot be split further.
+const size_t kMaxSpillSeed = 8;
+
+template <typename E>
+Run<E> spill(const E* begin, const E* end) {
+  const char* dir = getenv("TMPDIR");
+  std::string path = std::string(dir && *dir ? dir : "/tmp") + "/fn_XXXXXX";
+  const int fd = mkstemp(&path[0]);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "mkstemp " + path);
+  }
+
+  // The elements are contiguous already, so they are written as they are,
+  // without the buffers and the thread of a sink.
+  std::shared_ptr<const MappedFile> file;
+  try {
+    auto data = reinterpret_cast<const char*>(begin);
+    auto left = static_cast<size_t>(end - begin) * sizeof(E);
+    while (left > 0) {
+      const ssize_t n = write(fd, data, left);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+
+      if (n < 0) {
+        throw std::system_error(errno, std::generic_category(),
+                                "write " + path);
+      }
+
+      data += n;
+      left -= n;
+    }
+
+    file = std::make_shared<const MappedFile>(path);
+  } catch (...) {
+    close(fd);
+    unlink(path.c_str());
+    throw;
+  }
+
+  close(fd);
+  unlink(path.c_str());
+  const auto data = reinterpret_cast<const E*>(file->data());
+  return Run<E>{file, data, data + (end - begin)};
+}
+
+// Returns the partition of a key, from its hash mixed with a seed, so that the
+// partitions of small integers are spread, and the keys of a partition are
+// spread again with another seed.
+template <typename K>
+size_t spill_partition(const K& key, size_t seed) {
+  uint64_t h = std::hash<K>()(key) + (seed + 1) * 0x9e3779b97f4a7c15ull;
+  h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+  h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+  return static_cast<size_t>(h ^ (h >> 31)) % kSpillPartitions;
+}
+
+// Returns the number of groups of keys K and values V that fit in the given
+// number of bytes of a hash map.
+template <typename K, typename V>
+size_t group_capacity(size_t memory) {
+  return std::max<size_t>(
+      1, memory / (sizeof(std::pair<K, V>) + kHashEntryOverhead));
+}
+
+template <typename E, typename Cmp>
+ExternalSorter<E, Cmp>::ExternalSorter(size_t memory, Cmp cmp)
+    : cmp_(cmp), capacity_(std::max<size_t>(1, memory / sizeof(E))) {
+  static_assert(std::is_trivially_copyable<E>::value,
+                "Externally sorted elements must be trivially copyable");
+  run_.reserve(capacity_);
+}
+
+template <typename E, typename Cmp>
+void ExternalSorter<E, Cmp>::spill_run() {
+  std::sort(run_.begin(), run_.end(), cmp_);
+  runs_.push_back(spill(run_.data(), run_.data() + run_.size()));
+  run_.clear();
+}
+
+template <typename E, typename Cmp>
+SortedRuns<E> ExternalSorter<E, Cmp>::finish() {
+  // The last run is kept in memory.
+  if (!run_.empty()) {
+    std::sort(run_.begin(), run_.end(), cmp_);
+    auto last = std::make_shared<const std::vector<E>>(std::move(run_));
+    runs_.push_back(Run<E>{last, last->data(), last->data() + last->size()});
+  }
+
+  return SortedRuns<E>(std::move(runs_), cmp_);
+}
+
+template <typename K, typename V, typename G>
+ExternalReducer<K, V, G>::ExternalReducer(size_t memory, G reduce,
+                                          size_t seed)
+    : reduce_(reduce),
+      memory_(memory),
+      seed_(seed),
+      capacity_(group_capacity<K, V>(memory)) {
+  static_assert(std::is_trivially_copyable<K>::value &&
+                    std::is_trivially_copyable<V>::value,
+                "Externally reduced keys and values must be trivially "
+                "copyable");
+  groups_.reserve(capacity_);
+}
+
+// Returns the entries of the groups sorted by partition with the given seed,
+// and sets offsets to where each partition begins, followed by the number of
+// entries.
+template <typename K, typename V>
+std::vector<GroupEntry<K, V>> partition_groups(
+    const std::unordered_map<K, V>& groups, size_t seed,
+    std::vector<size_t>* offsets) {
+  offsets->assign(kSpillPartitions + 1, 0);
+  for (const auto& g : groups) {
+    (*offsets)[spill_partition(g.first, seed) + 1]++;
+  }
+
+  for (size_t p = 0; p < kSpillPartitions; p++) {
+    (*offsets)[p + 1] += (*offsets)[p];
+  }
+
+  std::vector<size_t> next(offsets->begin(), offsets->end() - 1);
+  std::vector<GroupEntry<K, V>> entries(groups.size());
+  for (const auto& g : groups) {
+    entries[next[spill_partition(g.first, seed)]++] =
+        GroupEntry<K, V>{g.first, g.second};
+  }
+
+  return entries;
+}
+
+template <typename K, typename V, typename G>
+void ExternalReducer<K, V, G>::spill_groups() {
+  std::vector<size_t> offsets;
+  const auto entries = partition_groups(groups_, seed_, &offsets);
+  runs_.push_back(spill(entries.data(), entries.data() + entries.size()));
+  offsets_.push_back(std::move(offsets));
+  groups_.clear();
+}
+
+template <typename K, typename V, typename G>
+Groups<std::pair<K, V>> ExternalReducer<K, V, G>::finish() {
+  if (runs_.empty()) {
+    return Groups<std::pair<K, V>>(
+        std::vector<std::pair<K, V>>(groups_.begin(), groups_.end()));
+  }
+
+  // The last groups are kept in memory, partitioned like the spilled ones.
+  if (!groups_.empty()) {
+    std::vector<size_t> offsets;
+    auto last = std::make_shared<const std::vector<GroupEntry<K, V>>>(
+        partition_groups(groups_, seed_, &offsets));
+    runs_.push_back(Run<GroupEntry<K, V>>{last, last->data(),
+                                          last->data() + last->size()});
+    offsets_.push_back(std::move(offsets));
+    groups_.clear();
+  }
+
+  return Groups<std::pair<K, V>>(std::move(runs_), std::move(offsets_),
+                                 reduce_, memory_, seed_);
+}
+
+}  // namespace details
+
+template <typename E>
+SortedRuns<E>::Iterator::Iterator(const std::vector<details::Run<E>>& runs,
+                                  const Compare* cmp)
+    : cmp_(cmp) {
+  for (const auto& run : runs) {
+    if (run.begin != run.end) {
+      heap_.emplace_back(run.begin, run.end);
+    }
+  }
+
+  std::make_heap(heap_.begin(), heap_.end(),
+                 [this](const std::pair<const E*, const E*>& a,
+                        const std::pair<const E*, const E*>& b) {
+                   return after(a, b);
+                 });
+}
+
+template <typename E>
+typename SortedRuns<E>::Iterator& SortedRuns<E>::Iterator::operator++() {
+  auto after = [this](const std::pair<const E*, const E*>& a,
+                      const std::pair<const E*, const E*>& b) {
+    return this->after(a, b);
+  };
+
+  std::pop_heap(heap_.begin(), heap_.end(), after);
+  if (++heap_.back().first == heap_.back().second) {
+    heap_.pop_back();
+  } else {
+    std::push_heap(heap_.begin(), heap_.end(), after);
+  }
+
+  return *this;
+}
+
+template <typename E>
+SortedRuns<E>::SortedRuns(std::vector<details::Run<E>> runs, Compare cmp)
+    : runs_(std::move(runs)), cmp_(std::move(cmp)), size_(0) {
+  for (const auto& run : runs_) {
+    size_ += run.end - run.begin;
+  }
+}
+
+template <typename K, typename V>
+Groups<std::pair<K, V>>::Iterator::Iterator(const Groups* owner,
+                                            size_t partition)
+    : levels_{Level{owner, nullptr, partition}}, index_(0) {
+  load();
+}
+
+template <typename K, typename V>
+void Groups<std::pair<K, V>>::Iterator::load() {
+  for (;;) {
+    auto& level = levels_.back();
+    if (level.partition == level.groups->partitions_) {
+      if (levels_.size() == 1) {
+        return;
+      }
+
+      levels_.pop_back();
+      levels_.back().partition++;
+    } else if (level.groups->groups_) {
+      if (!level.groups->groups_->empty()) {
+        return;
+      }
+
+      level.partition++;
+    } else {
+      auto groups = level.groups->partition(level.partition);
+      levels_.push_back(Level{groups.get(), std::move(groups), 0});
+    }
+  }
+}
+
+template <typename K, typename V>
+typename Groups<std::pair<K, V>>::Iterator&
+Groups<std::pair<K, V>>::Iterator::operator++() {
+  if (++index_ == levels_.back().groups->groups_->size()) {
+    index_ = 0;
+    levels_.back().partition++;
+    load();
+  }
+
+  return *this;
+}
+
+template <typename K, typename V>
+Groups<std::pair<K, V>>::Groups(std::vector<std::pair<K, V>> groups)
+    : partitions_(1),
+      groups_(std::make_shared<const std::vector<std::pair<K, V>>>(
+          std::move(groups))),
+      memory_(0),
+      seed_(0) {}
+
+template <typename K, typename V>
+Groups<std::pair<K, V>>::Groups(std::vector<details::Run<Entry>> runs,
+                                std::vector<std::vector<size_t>> offsets,
+                                Reduce reduce, size_t memory, size_t seed)
+    : partitions_(kSpillPartitions),
+      runs_(std::move(runs)),
+      offsets_(std::move(offsets)),
+      reduce_(std::move(reduce)),
+      memory_(memory),
+      seed_(seed),
+      cache_(std::make_shared<Cache>()) {}
+
+template <typename K, typename V>
+std::shared_ptr<const Groups<std::pair<K, V>>>
+Groups<std::pair<K, V>>::partition(size_t p) const {
+  {
+    std::lock_guard<std::mutex> lock(cache_->mutex);
+    if (cache_->groups && cache_->partition == p) {
+      return cache_->groups;
+    }
+  }
+
+  size_t entries = 0;
+  for (size_t i = 0; i < runs_.size(); i++) {
+    entries += offsets_[i][p + 1] - offsets_[i][p];
+  }
+
+  std::shared_ptr<const Groups> groups;
+  if (entries > details::group_capacity<K, V>(memory_) &&
+      seed_ < details::kMaxSpillSeed) {
+    details::ExternalReducer<K, V, Reduce> reducer(memory_, reduce_,
+                                                   seed_ + 1);
+    for (size_t i = 0; i < runs_.size(); i++) {
+      const auto begin = runs_[i].begin + offsets_[i][p];
+      const auto end = runs_[i].begin + offsets_[i][p + 1];
+      for (auto e = begin; e != end; ++e) {
+        reducer(std::make_pair(e->key, e->value));
+      }
+    }
+
+    groups = std::make_shared<const Groups>(reducer.finish());
+  } else {
+    std::unordered_map<K, V> reduced;
+    reduced.reserve(entries);
+    for (size_t i = 0; i < runs_.size(); i++) {
+      const auto begin = runs_[i].begin + offsets_[i][p];
+      const auto end = runs_[i].begin + offsets_[i][p + 1];
+      for (auto e = begin; e != end; ++e) {
+        auto it = reduced.find(e->key);
+        if (it == reduced.end()) {
+          reduced.emplace(e->key, e->value);
+        } else {
+          it->second = reduce_(it->second, e->value);
+        }
+      }
+    }
+
+    groups = std::make_shared<const Groups>(
+        std::vector<std::pair<K, V>>(reduced.begin(), reduced.end()));
+  }
+
+  std::lock_guard<std::mutex> lock(cache_->mutex);
+  cache_->partition = p;
+  cache_->groups = groups;
+  return groups;
+}
+
+}  // namespace fn
+
+#endif  // FUNC_EXTERNAL_INL_H_
@@ -0,0 +1,301 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_EXTERNAL_H_
+#define FUNC_EXTERNAL_H_
+
+#include <cstddef>
+
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "fn/mapped_file.h"
+
+namespace fn {
+
+// The number of partitions of the groups spilled by external_reduce_by().
+const size_t kSpillPartitions = 64;
+
+namespace details {
+
+// A sequence of elements stored contiguously, in memory or in a spilled file
+// mapped in memory, which owner keeps alive.
+template <typename E>
+struct Run {
+  std::shared_ptr<const void> owner;
+  const E* begin;
+  const E* end;
+};
+
+// Writes the elements in [begin, end) to a new temporary file in $TMPDIR (or
+// /tmp) directly from memory, and returns them mapped in memory. The file is
+// removed once mapped, so it is deleted along with the mapping. Throws
+// std::system_error on failure.
+template <typename E>
+Run<E> spill(const E* begin, const E* end);
+
+// The key and value of a group, as spilled.
+template <typename K, typename V>
+struct GroupEntry {
+  K key;
+  V value;
+};
+
+}  // namespace details
+
+// The elements of sorted runs, merged lazily as they are iterated. Runs are
+// sorted in memory and spilled to temporary files by View::external_sort(),
+// which returns views on SortedRuns.
+template <typename E>
+class SortedRuns {
+ public:
+  using value_type = E;
+  using Compare = std::function<bool(const E&, const E&)>;
+
+  // Iterates over the elements in order, keeping a heap of the next element of
+  // each run.
+  class Iterator : public std::iterator<std::forward_iterator_tag, E> {
+   public:
+    Iterator(const std::vector<details::Run<E>>& runs, const Compare* cmp);
+
+    const E& operator*() const { return *heap_.front().first; }
+
+    Iterator& operator++();
+
+    Iterator operator++(int) {
+      auto cp = *this;
+      ++*this;
+      return cp;
+    }
+
+    bool operator==(const Iterator& that) const { return heap_ == that.heap_; }
+    bool operator!=(const Iterator& that) const { return !(*this == that); }
+
+   private:
+    // Whether the run at a comes after the one at b.
+    bool after(const std::pair<const E*, const E*>& a,
+               const std::pair<const E*, const E*>& b) const {
+      return (*cmp_)(*b.first, *a.first);
+    }
+
+    std::vector<std::pair<const E*, const E*>> heap_;
+    const Compare* cmp_;
+  };
+
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+
+  SortedRuns(std::vector<details::Run<E>> runs, Compare cmp);
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Returns the number of runs merged.
+  size_t runs() const { return runs_.size(); }
+
+  Iterator begin() const { return Iterator(runs_, &cmp_); }
+  Iterator end() const { return Iterator({}, &cmp_); }
+
+ private:
+  std::vector<details::Run<E>> runs_;
+  Compare cmp_;
+  size_t size_;
+};
+
+// Views on groups name Groups<E> as the container of their stages. Only Groups
+// of pairs are ever constructed.
+template <typename E>
+class Groups {};
+
+// The values of a set of keys, reduced by View::external_reduce_by() in
+// partitions of the keys that each fit in memory. Partitions that were spilled
+// are reduced lazily, one at a time, as the groups are iterated. A partition
+// with more entries than fit in memory is reduced again into groups spilled by
+// partitions of another hash of the keys, and so on.
+template <typename K, typename V>
+class Groups<std::pair<K, V>> {
+ public:
+  using value_type = std::pair<K, V>;
+  using Entry = details::GroupEntry<K, V>;
+  using Reduce = std::function<V(const V&, const V&)>;
+
+  class Iterator : public std::iterator<std::forward_iterator_tag,
+                                        std::pair<K, V>> {
+   public:
+    Iterator(const Groups* groups, size_t partition);
+
+    const std::pair<K, V>& operator*() const {
+      return (*levels_.back().groups->groups_)[index_];
+    }
+
+    Iterator& operator++();
+
+    Iterator operator++(int) {
+      auto cp = *this;
+      ++*this;
+      return cp;
+    }
+
+    bool operator==(const Iterator& that) const {
+      if (levels_.size() != that.levels_.size() || index_ != that.index_) {
+        return false;
+      }
+
+      for (size_t i = 0; i < levels_.size(); i++) {
+        if (levels_[i].partition != that.levels_[i].partition) {
+          return false;
+        }
+      }
+
+      return true;
+    }
+
+    bool operator!=(const Iterator& that) const { return !(*this == that); }
+
+   private:
+    // A partition of groups being iterated, which owner keeps alive unless
+    // they are the groups iterated.
+    struct Level {
+      const Groups* groups;
+      std::shared_ptr<const Groups> owner;
+      size_t partition;
+    };
+
+    // Moves to the first group from the current partition of each level on,
+    // descending into the partitions that were spilled.
+    void load();
+
+    std::vector<Level> levels_;
+    size_t index_;
+  };
+
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+
+  // Groups reduced in memory.
+  explicit Groups(std::vector<std::pair<K, V>> groups);
+
+  // Groups spilled in runs of entries sorted by partition, where the entries of
+  // partition p of the run i are in [runs[i].begin + offsets[i][p],
+  // runs[i].begin + offsets[i][p + 1]). The keys were partitioned with the
+  // given seed, and each partition is reduced in the given memory.
+  Groups(std::vector<details::Run<Entry>> runs,
+         std::vector<std::vector<size_t>> offsets, Reduce reduce,
+         size_t memory, size_t seed);
+
+  // Returns the number of partitions, reduced one at a time.
+  size_t partitions() const { return partitions_; }
+
+  Iterator begin() const { return Iterator(this, 0); }
+  Iterator end() const { return Iterator(this, partitions_); }
+
+ private:
+  // The partition reduced last, kept for iterators that start over.
+  struct Cache {
+    std::mutex mutex;
+    size_t partition;
+    std::shared_ptr<const Groups> groups;
+  };
+
+  // Returns the groups of the given partition, reduced in memory, or spilled
+  // again if there are too many of them.
+  std::shared_ptr<const Groups> partition(size_t p) const;
+
+  size_t partitions_;
+  std::shared_ptr<const std::vector<std::pair<K, V>>> groups_;
+  std::vector<details::Run<Entry>> runs_;
+  std::vector<std::vector<size_t>> offsets_;
+  Reduce reduce_;
+  size_t memory_;
+  size_t seed_;
+  std::shared_ptr<Cache> cache_;
+};
+
+namespace details {
+
+// Sorts elements in runs of at most a given number of bytes, spilling all but
+// the last run.
+template <typename E, typename Cmp>
+class ExternalSorter {
+ public:
+  ExternalSorter(size_t memory, Cmp cmp);
+
+  void operator()(const E& e) {
+    run_.push_back(e);
+    if (run_.size() == capacity_) {
+      spill_run();
+    }
+  }
+
+  SortedRuns<E> finish();
+
+ private:
+  void spill_run();
+
+  Cmp cmp_;
+  size_t capacity_;
+  std::vector<E> run_;
+  std::vector<Run<E>> runs_;
+};
+
+// Reduces the values of each key in a hash map of at most a given number of
+// bytes, spilling it by partitions of the keys, hashed with the given seed,
+// when full.
+template <typename K, typename V, typename G>
+class ExternalReducer {
+ public:
+  ExternalReducer(size_t memory, G reduce, size_t seed = 0);
+
+  template <typename A, typename B>
+  void operator()(const std::pair<A, B>& e) {
+    auto it = groups_.find(e.first);
+    if (it != groups_.end()) {
+      it->second = reduce_(it->second, e.second);
+      return;
+    }
+
+    groups_.emplace(e.first, e.second);
+    if (groups_.size() == capacity_) {
+      spill_groups();
+    }
+  }
+
+  Groups<std::pair<K, V>> finish();
+
+ private:
+  void spill_groups();
+
+  G reduce_;
+  size_t memory_;
+  size_t seed_;
+  size_t capacity_;
+  std::unordered_map<K, V> groups_;
+  std::vector<Run<GroupEntry<K, V>>> runs_;
+  std::vector<std::vector<size_t>> offsets_;
+};
+
+}  // namespace details
+
+}  // namespace fn
+
+#include "fn/external-inl.h"
+
+#endif  // FUNC_EXTERNAL_H_
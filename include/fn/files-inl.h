@@ -0,0 +1,238 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_FILES_INL_H_
+#define FUNC_FILES_INL_H_
+
+#include <cerrno>
+
+#include <algorithm>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fn {
+namespace details {
+
+inline std::shared_ptr<FileReader> FileReader::start(
+    std::shared_ptr<const std::vector<std::string>> paths, FileOrder order,
+    size_t threads) {
+  auto reader = std::make_shared<FileReader>(std::move(paths), order, threads);
+  for (size_t i = 0; i < reader->depth_; i++) {
+    reader->threads_.emplace_back([reader]() { reader->run(); });
+  }
+
+  return reader;
+}
+
+inline FileReader::FileReader(
+    std::shared_ptr<const std::vector<std::string>> paths, FileOrder order,
+    size_t threads)
+    : paths_(std::move(paths)),
+      order_(order),
+      depth_(std::max<size_t>(1, std::min(threads, paths_->size()))),
+      claimed_(0),
+      outstanding_(0),
+      delivered_(0),
+      current_{0, nullptr, 0},
+      file_{0, StringView(), StringView()},
+      stopped_(false) {}
+
+inline const File* FileReader::next() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (current_.data != nullptr) {
+    current_.data.reset();
+    outstanding_--;
+    cond_.notify_all();
+  }
+
+  // In the order of the paths, files are claimed in order, so the next one is
+  // always being read or ready.
+  auto next = ready_.end();
+  cond_.wait(lock, [&] {
+    next = order_ == FileOrder::COMPLETION
+               ? ready_.begin()
+               : std::find_if(ready_.begin(), ready_.end(),
+                              [&](const Contents& c) {
+                                return c.index == delivered_;
+                              });
+    return next != ready_.end() || error_ || delivered_ == paths_->size();
+  });
+
+  if (next == ready_.end()) {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+
+    return nullptr;
+  }
+
+  current_ = std::move(*next);
+  ready_.erase(next);
+  delivered_++;
+  file_ = File{current_.index, StringView((*paths_)[current_.index]),
+               StringView(current_.data.get(), current_.size)};
+  return &file_;
+}
+
+inline void FileReader::stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stopped_ = true;
+  cond_.notify_all();
+  for (auto& thread : threads_) {
+    thread.detach();
+  }
+}
+
+inline void FileReader::run() {
+  try {
+    for (;;) {
+      size_t i;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [&] {
+          return outstanding_ < depth_ || stopped_ || error_;
+        });
+
+        if (stopped_ || error_ || claimed_ == paths_->size()) {
+          break;
+        }
+
+        i = claimed_++;
+        outstanding_++;
+      }
+
+      auto contents = read_file(i, (*paths_)[i]);
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_.push_back(std::move(contents));
+      cond_.notify_all();
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!error_) {
+      error_ = std::current_exception();
+    }
+
+    cond_.notify_all();
+  }
+}
+
+inline FileReader::Contents FileReader::read_file(size_t index,
+                                                  const std::string& path) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    const int error = errno;
+    close(fd);
+    throw std::system_error(error, std::generic_category(), "stat " + path);
+  }
+
+#if defined(POSIX_FADV_SEQUENTIAL)
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  // Files that shrink while read are truncated, and those that grow are not.
+  Contents contents{index, std::unique_ptr<char[]>(new char[st.st_size + 1]),
+                    0};
+  while (contents.size < static_cast<size_t>(st.st_size)) {
+    const ssize_t n = pread(fd, contents.data.get() + contents.size,
+                            st.st_size - contents.size, contents.size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0) {
+      const int error = errno;
+      close(fd);
+      throw std::system_error(error, std::generic_category(), "read " + path);
+    }
+
+    if (n == 0) {
+      break;
+    }
+
+    contents.size += n;
+  }
+
+  close(fd);
+  return contents;
+}
+
+}  // namespace details
+
+template <typename E>
+Files<E>::Iterator::Iterator(std::shared_ptr<details::FileReader> reader)
+    : reader_(std::move(reader)),
+      file_(reader_ == nullptr ? nullptr : reader_->next()) {}
+
+template <typename E>
+typename Files<E>::Iterator& Files<E>::Iterator::operator++() {
+  file_ = reader_->next();
+  return *this;
+}
+
+template <typename E>
+Files<E>::Files(std::vector<std::string> paths, FileOrder order,
+                size_t threads)
+    : reads_(new Reads{std::make_shared<const std::vector<std::string>>(
+                           std::move(paths)),
+                       order, threads, nullptr}) {}
+
+template <typename E>
+typename Files<E>::Iterator Files<E>::begin() const {
+  if (reads_->reader == nullptr) {
+    reads_->reader =
+        details::FileReader::start(reads_->paths, reads_->order,
+                                   reads_->threads);
+  }
+
+  return Iterator(reads_->reader);
+}
+
+template <typename E>
+std::vector<Files<E>> Files<E>::split(size_t n) const {
+  std::vector<Files> parts;
+  const auto& paths = *reads_->paths;
+  n = std::min(n, paths.size());
+  for (size_t i = 0; i < n; i++) {
+    parts.push_back(Files(
+        std::vector<std::string>(paths.begin() + paths.size() * i / n,
+                                 paths.begin() + paths.size() * (i + 1) / n),
+        reads_->order, reads_->threads));
+  }
+
+  return parts;
+}
+
+template <typename E>
+Files<E>::Reads::~Reads() {
+  if (reader != nullptr) {
+    reader->stop();
+  }
+}
+
+inline Files<> files(std::vector<std::string> paths, FileOrder order,
+                     size_t threads) {
+  return Files<>(std::move(paths), order, threads);
+}
+
+}  // namespace fn
+
+#endif  // FUNC_FILES_INL_H_
@@ -0,0 +1,192 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_FILES_H_
+#define FUNC_FILES_H_
+
+#include <cstddef>
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "fn/string_view.h"
+
+namespace fn {
+
+// The contents of a file read by fn::files(): its position in the list of
+// paths, its path and its data.
+struct File {
+  size_t index;
+  StringView path;
+  StringView data;
+};
+
+// The order in which fn::files() yields files.
+enum class FileOrder {
+  // The order of the list of paths, which is deterministic.
+  PATHS,
+  // The order in which reads complete, which never waits for a slow file.
+  COMPLETION,
+};
+
+// The default number of files read at the same time.
+const size_t kFileReaders = 8;
+
+namespace details {
+
+// Reads a list of files on a pool of threads, each reading a whole file with
+// pread. Reading stays at most as many files ahead of the consumer as there
+// are threads.
+class FileReader {
+ public:
+  // Starts reading the files. The reader is shared with its threads, which
+  // exit once all the files are read, or once stopped, at the end of the file
+  // they are reading.
+  static std::shared_ptr<FileReader> start(
+      std::shared_ptr<const std::vector<std::string>> paths, FileOrder order,
+      size_t threads);
+
+  FileReader(std::shared_ptr<const std::vector<std::string>> paths,
+             FileOrder order, size_t threads);
+
+  // Releases the current file, and returns the next one, or nullptr once all
+  // are read. Throws std::system_error if a file cannot be read.
+  const File* next();
+
+  // Stops reading without waiting for the threads.
+  void stop();
+
+ private:
+  struct Contents {
+    size_t index;
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  void run();
+
+  // Reads the whole file at path.
+  static Contents read_file(size_t index, const std::string& path);
+
+  const std::shared_ptr<const std::vector<std::string>> paths_;
+  const FileOrder order_;
+  const size_t depth_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::vector<std::thread> threads_;
+
+  // The number of files claimed by a thread, of files claimed and not released
+  // yet, and of files returned.
+  size_t claimed_;
+  size_t outstanding_;
+  size_t delivered_;
+
+  std::deque<Contents> ready_;
+  Contents current_;
+  File file_;
+  bool stopped_;
+  std::exception_ptr error_;
+};
+
+}  // namespace details
+
+// The contents of a list of files, as elements of type E (ie, File), read
+// ahead by a pool of threads while the previous ones are processed. A file is
+// valid until the next one is read.
+//
+// Reading starts at the first call to begin(). Files can only be iterated
+// once: copies share the reads, and iterators are input iterators.
+template <typename E = File>
+class Files {
+ public:
+  class Iterator : public std::iterator<std::input_iterator_tag, E> {
+   public:
+    explicit Iterator(std::shared_ptr<details::FileReader> reader);
+
+    const E& operator*() const { return *file_; }
+    const E* operator->() const { return file_; }
+
+    Iterator& operator++();
+
+    bool operator==(const Iterator& that) const {
+      return file_ == that.file_;
+    }
+
+    bool operator!=(const Iterator& that) const {
+      return file_ != that.file_;
+    }
+
+   private:
+    std::shared_ptr<details::FileReader> reader_;
+    const File* file_;
+  };
+
+  // For compability with stl.
+  using value_type = E;
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+
+  Files(std::vector<std::string> paths, FileOrder order, size_t threads);
+
+  Iterator begin() const;
+  Iterator end() const { return Iterator(nullptr); }
+
+  // The number of files.
+  size_t size() const { return reads_->paths->size(); }
+  bool empty() const { return size() == 0; }
+
+  // Splits the files into at most n parts of about the same number of files,
+  // each read by a pool of its own. The parts can be processed in parallel,
+  // each with its own view.
+  std::vector<Files> split(size_t n) const;
+
+ private:
+  struct Reads {
+    ~Reads();
+
+    std::shared_ptr<const std::vector<std::string>> paths;
+    FileOrder order;
+    size_t threads;
+    std::shared_ptr<details::FileReader> reader;
+  };
+
+  std::shared_ptr<Reads> reads_;
+};
+
+// Reads the files at the given paths, for creating a view on their contents:
+//
+//   auto lines = _(fn::files(paths)).map([](const fn::File& file) {
+//     return std::count(file.data.begin(), file.data.end(), '\n');
+//   }).sum();
+//
+// Up to threads files are read at the same time, and yielded in the given
+// order.
+Files<> files(std::vector<std::string> paths,
+              FileOrder order = FileOrder::PATHS,
+              size_t threads = kFileReaders);
+
+}  // namespace fn
+
+#include "fn/files-inl.h"
+
+#endif  // FUNC_FILES_H_
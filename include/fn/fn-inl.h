@@ -15,6 +15,7 @@
 #ifndef FUNC_FUNC_INL_H_
 #define FUNC_FUNC_INL_H_
 
+#include <algorithm>
 #include <cassert>
 #include <deque>
 #include <list>
@@ -43,6 +44,14 @@ class Private {
 
   template <template <typename...> class C, typename E>
   friend View<C, E, fn::details::Ref> fn::_(const C<E>* c);
+
+  template <template <typename...> class C, typename E>
+  friend View<C, E, fn::details::SortedCopy> fn::_(
+      fn::details::Sorted<C<E>> s);
+
+  template <template <typename...> class C, typename E>
+  friend View<C, E, fn::details::SortedRef> fn::_(
+      fn::details::Sorted<const C<E>*> s);
 };
 
 }  // namespace details
@@ -76,7 +85,16 @@ View<C, E, R, P, F, t>::View(const View& that)
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
-template <typename G>
+template <typename G,
+          typename std::enable_if<
+              sizeof(G) &&
+                  (std::is_same<void*, P>::value ||
+                   (t != fn::details::FuncType::FILTER &&
+                    t != fn::details::FuncType::MAP &&
+                    t != fn::details::FuncType::MAP_FILTER) ||
+                   fn::details::is_slice_filter<View<C, E, R, P, F, t>,
+                                                G>::value),
+              int>::type>
 typename View<C, E, R, P, F, t>::template FView<G>
 View<C, E, R, P, F, t>::filter(G g) const {
   return View<C, E, R, View, G>(*this, g, fn::details::Private());
@@ -85,26 +103,171 @@ View<C, E, R, P, F, t>::filter(G g) const {
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
-template <typename G>
-auto View<C, E, R, P, F, t>::map(G g)
+template <typename G,
+          typename std::enable_if<
+              sizeof(G) && !std::is_same<void*, P>::value &&
+                  t == fn::details::FuncType::FILTER &&
+                  !fn::details::is_slice_filter<View<C, E, R, P, F, t>,
+                                                G>::value,
+              int>::type>
+typename View<C, E, R, P, F, t>::template FView<G>
+View<C, E, R, P, F, t>::filter(G g) const {
+  return FView<G>(parent_, fn::details::conjoin(func_, g),
+                  fn::details::Private());
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G, typename std::enable_if<
+                        sizeof(G) && !std::is_same<void*, P>::value &&
+                            t == fn::details::FuncType::MAP,
+                        int>::type>
+typename View<C, E, R, P, F, t>::template FView<G>
+View<C, E, R, P, F, t>::filter(G g) const {
+  return FView<G>(parent_, fn::details::MapFilter<F, G>(func_, g),
+                  fn::details::Private());
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G, typename std::enable_if<
+                        sizeof(G) && !std::is_same<void*, P>::value &&
+                            t == fn::details::FuncType::MAP_FILTER,
+                        int>::type>
+typename View<C, E, R, P, F, t>::template FView<G>
+View<C, E, R, P, F, t>::filter(G g) const {
+  using Pred = typename fn::details::Conjoined<typename F::Pred, G>::type;
+  return FView<G>(parent_, fn::details::MapFilter<typename F::Map, Pred>(
+                               func_.map, fn::details::conjoin(func_.pred, g)),
+                  fn::details::Private());
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G,
+          typename std::enable_if<
+              sizeof(G) &&
+                  ((std::is_same<void*, P>::value &&
+                    !fn::details::is_column_projection<C<E>, G>::value) ||
+                   (!std::is_same<void*, P>::value &&
+                    t != fn::details::FuncType::MAP)),
+              int>::type>
+auto View<C, E, R, P, F, t>::map(G g) const
     -> typename View<C, E, R, P, F, t>::template MView<
-          decltype(g(*(E*) nullptr)), G> const {
+          decltype(g(*(E*) nullptr)), G> {
   return View<C, typename std::decay<decltype(g(*(E*)nullptr))>::type, R, View,
               G, fn::details::FuncType::MAP>(*this, g, fn::details::Private());
 }
 
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G, typename std::enable_if<
+                        sizeof(G) && std::is_same<void*, P>::value &&
+                            fn::details::is_column_projection<C<E>, G>::value,
+                        int>::type>
+auto View<C, E, R, P, F, t>::map(G g) const
+    -> typename View<C, E, R, P, F, t>::template MView<
+          decltype(g(*(E*) nullptr)), G> {
+  return MView<decltype(g(*(E*)nullptr)), G>(
+      container_->template column<G::index>(), fn::details::Private());
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G, typename std::enable_if<
+                        sizeof(G) && !std::is_same<void*, P>::value &&
+                            t == fn::details::FuncType::MAP,
+                        int>::type>
+auto View<C, E, R, P, F, t>::map(G g) const
+    -> typename View<C, E, R, P, F, t>::template MView<
+          decltype(g(*(E*) nullptr)), G> {
+  return MView<decltype(g(*(E*)nullptr)), G>(
+      parent_, fn::details::compose(func_, g),
+      fn::details::Private());
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+typename View<C, E, R, P, F, t>::template FView<ContainsAny>
+View<C, E, R, P, F, t>::filter_contains_any(
+    const std::vector<std::string>& patterns) const {
+  return filter(ContainsAny(patterns));
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename T, typename std::enable_if<
+                        sizeof(T) && !std::is_same<void*, P>::value &&
+                            t == fn::details::FuncType::FILTER,
+                        int>::type>
+View<C, E, R, P, fn::details::BitmapFilter<F>> View<C, E, R, P, F, t>::bitmap()
+    const {
+  return View<C, E, R, P, fn::details::BitmapFilter<F>>(
+      parent_, fn::details::BitmapFilter<F>(func_), fn::details::Private());
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename T, typename std::enable_if<
+                        sizeof(T) && !std::is_same<void*, P>::value &&
+                            t == fn::details::FuncType::FILTER,
+                        int>::type>
+View<C, E, R, P, fn::details::AdaptiveFilter<F>>
+View<C, E, R, P, F, t>::adaptive() const {
+  return View<C, E, R, P, fn::details::AdaptiveFilter<F>>(
+      parent_, fn::details::AdaptiveFilter<F>(func_), fn::details::Private());
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename V>
+typename fn::details::Probed<V>::type View<C, E, R, P, F, t>::profile(
+    Profile* report) const {
+  long index;
+  return probe(report, &index);
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+std::string View<C, E, R, P, F, t>::explain() const {
+  std::string plan;
+  explain(&plan, 0);
+  return plan;
+}
+
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
 template <typename G>
-auto View<C, E, R, P, F, t>::flat_map(G g)
-    -> View<C, typename decltype(g(*(E*) nullptr))::value_type, R, View, G,
-            fn::details::FuncType::FLAT_MAP> const {
-  return View<C, typename decltype(g(*(E*)nullptr))::value_type, R, View, G,
+auto View<C, E, R, P, F, t>::flat_map(G g) const -> View<
+    C, typename fn::details::inner_element<
+           typename std::decay<decltype(g(*(E*) nullptr))>::type>::type,
+    R, View, G, fn::details::FuncType::FLAT_MAP> {
+  using Inner = typename std::decay<decltype(g(*(E*)nullptr))>::type;
+  return View<C, typename fn::details::inner_element<Inner>::type, R, View, G,
               fn::details::FuncType::FLAT_MAP>(*this, g,
                                                fn::details::Private());
 }
 
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+View<C, StringView, R, View<C, E, R, P, F, t>, fn::details::Tokenizer,
+     fn::details::FuncType::FLAT_MAP>
+View<C, E, R, P, F, t>::split(StringView delims) const {
+  return flat_map(fn::details::Tokenizer(delims));
+}
+
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
@@ -114,7 +277,7 @@ T View<C, E, R, P, F, t>::fold_left(T init, G g) const {
     // TODO(soheil): Is this valid?
     init = std::move(g(std::move(init), e));
   });
-  return std::move(init);
+  return init;
 }
 
 template <template <typename...> class C, typename E,  // clang-format.
@@ -132,7 +295,7 @@ E View<C, E, R, P, F, t>::reduce(G g) const {
     }
     init = g(init, e);
   });
-  return std::move(init);
+  return init;
 }
 
 template <template <typename...> class C, typename E,  // clang-format.
@@ -143,6 +306,16 @@ void View<C, E, R, P, F, t>::for_each(G g) const {
   do_evaluate([&](const E& e) { g(e); });
 }
 
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+void View<C, E, R, P, F, t>::to_file(const std::string& path,
+                                     WriteMode mode) const {
+  const auto sink = binary_sink(path, mode);
+  for_each(sink);
+  sink.close();
+}
+
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
@@ -163,6 +336,18 @@ View<C, E, R, P, F, t>::keep_while(G g) const {
       *this, g, fn::details::Private());
 }
 
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+View<Async, E> View<C, E, R, P, F, t>::async() const {
+  const View self(*this);
+  return View<Async, E>(Async<E>([self](fn::details::AsyncQueue<E>* queue) {
+                          self.do_evaluate(
+                              [queue](const E& e) { queue->push(e); });
+                        }),
+                        fn::details::Private());
+}
+
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
@@ -204,6 +389,11 @@ E View<C, E, R, P, F, t>::first() const {
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
+template <typename T,
+          typename std::enable_if<
+              sizeof(T) && (!std::is_same<void*, P>::value ||
+                            !fn::details::is_sorted_view<R, P, t>::value),
+              int>::type>
 E View<C, E, R, P, F, t>::last() const {
   E last;
   do_evaluate([&](const E& e) {
@@ -217,6 +407,24 @@ E View<C, E, R, P, F, t>::last() const {
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
+template <typename T,
+          typename std::enable_if<
+              sizeof(T) && std::is_same<void*, P>::value &&
+                  fn::details::is_sorted_view<R, P, t>::value,
+              int>::type>
+E View<C, E, R, P, F, t>::last() const {
+  auto b = container_->begin();
+  auto e = container_->end();
+  return b == e ? E{} : *--e;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename T,
+          typename std::enable_if<
+              sizeof(T) && !fn::details::is_sorted_view<R, P, t>::value,
+              int>::type>
 E View<C, E, R, P, F, t>::max() const {
   return reduce([](const E& m, const E& e) { return std::max(m, e); });
 }
@@ -224,6 +432,21 @@ E View<C, E, R, P, F, t>::max() const {
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
+template <typename T,
+          typename std::enable_if<
+              sizeof(T) && fn::details::is_sorted_view<R, P, t>::value,
+              int>::type>
+E View<C, E, R, P, F, t>::max() const {
+  return last();
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename T,
+          typename std::enable_if<
+              sizeof(T) && !fn::details::is_sorted_view<R, P, t>::value,
+              int>::type>
 E View<C, E, R, P, F, t>::min() const {
   return reduce([](const E& m, const E& e) { return std::min(m, e); });
 }
@@ -231,12 +454,39 @@ E View<C, E, R, P, F, t>::min() const {
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
+template <typename T,
+          typename std::enable_if<
+              sizeof(T) && fn::details::is_sorted_view<R, P, t>::value,
+              int>::type>
+E View<C, E, R, P, F, t>::min() const {
+  return first();
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename T,
+          typename std::enable_if<
+              sizeof(T) && !fn::details::is_bitmap_stage<P, F>::value,
+              int>::type>
 size_t View<C, E, R, P, F, t>::size() const {
   size_t size = 0;
   do_evaluate([&](const E& /* e */) { size++; });
   return size;
 }
 
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename T,
+          typename std::enable_if<
+              sizeof(T) && fn::details::is_bitmap_stage<P, F>::value,
+              int>::type>
+size_t View<C, E, R, P, F, t>::size() const {
+  const auto& c = *parent_.container_;
+  return fn::details::count_bitmap(c.data(), c.size(), func_.pred);
+}
+
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
@@ -259,9 +509,9 @@ template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
 template <typename G>
-auto View<C, E, R, P, F, t>::operator*(G g)
+auto View<C, E, R, P, F, t>::operator*(G g) const
     -> typename View<C, E, R, P, F, t>::template MView<
-          decltype(g(*(E*) nullptr)), G> const {
+          decltype(g(*(E*) nullptr)), G> {
   return map(g);
 }
 
@@ -331,9 +581,47 @@ template <typename G,
 void View<C, E, R, P, F, t>::do_evaluate(G g) const {
   assert(is_evaluated() && "Cannot evaluate a view without a parent.");
 
-  for (const auto& e : *container_) {
+  fn::details::for_each_element(*container_, g);
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G,
+          typename std::enable_if<
+              sizeof(G) && !std::is_same<void*, P>::value &&
+                  t == fn::details::FuncType::FILTER &&
+                  !fn::details::is_batched_stage<P, F>::value &&
+                  !fn::details::is_bitmap_stage<P, F>::value &&
+                  !fn::details::is_adaptive_filter<F>::value &&
+                  !fn::details::is_block_range_stage<P, F>::value &&
+                  !(fn::details::is_range_filter<F>::value &&
+                    fn::details::is_sliceable_view<R, P, t>::value),
+              int>::type>
+void View<C, E, R, P, F, t>::do_evaluate(G g) const {
+  using PE = typename std::decay<typename P::Element>::type;
+
+  parent_.do_evaluate([this, &g](const PE& e) {
+    if (!func_(e)) {
+      return;
+    }
+
     g(e);
-  }
+  });
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G,
+          typename std::enable_if<
+              sizeof(G) && !std::is_same<void*, P>::value &&
+                  t == fn::details::FuncType::FILTER &&
+                  fn::details::is_range_filter<F>::value &&
+                  fn::details::is_sliceable_view<R, P, t>::value,
+              int>::type>
+void View<C, E, R, P, F, t>::do_evaluate(G g) const {
+  parent_.do_evaluate_slice(func_, g);
 }
 
 template <template <typename...> class C, typename E,  // clang-format.
@@ -341,12 +629,79 @@ template <template <typename...> class C, typename E,  // clang-format.
           fn::details::FuncType t>
 template <typename G,
           typename std::enable_if<sizeof(G) && !std::is_same<void*, P>::value &&
-                                      t == fn::details::FuncType::FILTER,
+                                      t == fn::details::FuncType::FILTER &&
+                                      fn::details::is_bitmap_stage<P, F>::value,
+                                  int>::type>
+void View<C, E, R, P, F, t>::do_evaluate(G g) const {
+  const auto& c = *parent_.container_;
+  fn::details::filter_bitmap(c.data(), c.size(), func_.pred, g);
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G,
+          typename std::enable_if<
+              sizeof(G) && !std::is_same<void*, P>::value &&
+                  t == fn::details::FuncType::FILTER &&
+                  fn::details::is_block_range_stage<P, F>::value,
+              int>::type>
+void View<C, E, R, P, F, t>::do_evaluate(G g) const {
+  parent_.container_->for_each_between(func_.lo, func_.hi, g);
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G,
+          typename std::enable_if<sizeof(G) && !std::is_same<void*, P>::value &&
+                                      t == fn::details::FuncType::FILTER &&
+                                      fn::details::is_adaptive_filter<F>::value,
                                   int>::type>
 void View<C, E, R, P, F, t>::do_evaluate(G g) const {
   using PE = typename std::decay<typename P::Element>::type;
+  using Flat = fn::details::Flattened<typename F::Pred>;
 
-  parent_.do_evaluate([this, &g](const PE& e) {
+  // The order is local to this evaluation, so views stay safe to share.
+  auto preds = Flat::get(func_.pred);
+  fn::details::AdaptiveOrder<typename Flat::type, PE> order(preds);
+  parent_.do_evaluate([&g, &order](const PE& e) {
+    if (!order(e)) {
+      return;
+    }
+
+    g(e);
+  });
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename B, typename G,
+          typename std::enable_if<sizeof(G) && std::is_same<void*, P>::value,
+                                  int>::type>
+void View<C, E, R, P, F, t>::do_evaluate_slice(const B& b, G g) const {
+  assert(sorted && "Cannot slice a view that is not sorted.");
+
+  auto end = container_->end();
+  auto lo = std::lower_bound(container_->begin(), end, b.lo);
+  auto hi = std::upper_bound(lo, end, b.hi);
+  for (; lo != hi; ++lo) {
+    g(*lo);
+  }
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename B, typename G,
+          typename std::enable_if<sizeof(G) && !std::is_same<void*, P>::value &&
+                                      t == fn::details::FuncType::FILTER,
+                                  int>::type>
+void View<C, E, R, P, F, t>::do_evaluate_slice(const B& b, G g) const {
+  using PE = typename std::decay<typename P::Element>::type;
+
+  parent_.do_evaluate_slice(b, [this, &g](const PE& e) {
     if (!func_(e)) {
       return;
     }
@@ -355,6 +710,168 @@ void View<C, E, R, P, F, t>::do_evaluate(G g) const {
   });
 }
 
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename B, typename G,
+          typename std::enable_if<sizeof(G) && !std::is_same<void*, P>::value &&
+                                      t == fn::details::FuncType::PROBE,
+                                  int>::type>
+void View<C, E, R, P, F, t>::do_evaluate_slice(const B& b, G g) const {
+  using PE = typename std::decay<typename P::Element>::type;
+
+  fn::details::ProbeRun<G> run(func_, &g);
+  parent_.do_evaluate_slice(b, [&run](const PE& e) { run(e); });
+  run.finish(fn::details::first_stage_input(parent_));
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename T,
+          typename std::enable_if<sizeof(T) && std::is_same<void*, P>::value,
+                                  int>::type>
+View<C, E, R, P, F, t> View<C, E, R, P, F, t>::probe(
+    Profile* /* report */, long* index) const {
+  *index = -1;
+  return *this;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename V,
+          typename std::enable_if<sizeof(V) && !std::is_same<void*, P>::value,
+                                  int>::type>
+typename fn::details::Probed<V>::type View<C, E, R, P, F, t>::probe(
+    Profile* report, long* index) const {
+  using Stage = typename fn::details::Probed<V>::Stage;
+  using Probed = typename fn::details::Probed<V>::type;
+
+  long parent;
+  Stage stage(probe_parent(parent_, report, &parent), func_,
+              fn::details::Private());
+  *index = report->add(t, parent);
+  return Probed(stage, fn::details::Probe(report, *index),
+                fn::details::Private());
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename V>
+typename fn::details::Probed<V>::type View<C, E, R, P, F, t>::probe_parent(
+    const V& v, Profile* report, long* index) {
+  return v.probe(report, index);
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename V1, typename V2>
+typename fn::details::Probed<std::pair<V1, V2>>::type
+View<C, E, R, P, F, t>::probe_parent(const std::pair<V1, V2>& p,
+                                     Profile* report, long* index) {
+  long first;
+  auto probed_first = p.first.probe(report, &first);
+  return std::make_pair(probed_first, p.second.probe(report, index));
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename T,
+          typename std::enable_if<sizeof(T) && std::is_same<void*, P>::value,
+                                  int>::type>
+fn::details::Estimate View<C, E, R, P, F, t>::explain(std::string* plan,
+                                                      size_t depth) const {
+  const auto rows = fn::details::estimate_root(*container_, 0);
+  *plan += std::string(2 * depth, ' ') + "root " +
+           fn::details::type_name<C<E>>() + " by " +
+           fn::details::policy_name<R>::value() + " (" + rows.to_string() +
+           ")";
+  if (depth > 0 && fn::details::is_heap_copy<R, C<E>>::value) {
+    *plan += ": warning: the container is copied with each stage, consider "
+             "passing a pointer";
+  }
+
+  *plan += "\n";
+  return rows;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename T, typename std::enable_if<
+                        sizeof(T) && !std::is_same<void*, P>::value &&
+                            t != fn::details::FuncType::ZIP,
+                        int>::type>
+fn::details::Estimate View<C, E, R, P, F, t>::explain(std::string* plan,
+                                                      size_t depth) const {
+  std::string parent_plan;
+  const auto rows =
+      fn::details::estimate(t, parent_.explain(&parent_plan, depth + 1));
+  *plan += std::string(2 * depth, ' ') + fn::details::func_type_name(t) +
+           " (" + rows.to_string() + ")";
+  if (fn::details::is_batched_stage<P, F>::value) {
+    *plan += ": evaluated in batches";
+  } else if (fn::details::is_bitmap_stage<P, F>::value) {
+    *plan += ": evaluated using bitmaps";
+  } else if (fn::details::is_adaptive_filter<F>::value) {
+    *plan += ": predicates reordered at run time";
+  } else if (fn::details::is_block_range_stage<P, F>::value) {
+    *plan += ": skipping blocks outside of the range";
+  } else if (t == fn::details::FuncType::FILTER &&
+             fn::details::is_range_filter<F>::value &&
+             fn::details::is_sliceable_view<R, P, t>::value) {
+    *plan += ": evaluated using a binary search";
+  }
+
+  *plan += "\n" + parent_plan;
+  return rows;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename T, typename std::enable_if<
+                        sizeof(T) && !std::is_same<void*, P>::value &&
+                            t == fn::details::FuncType::ZIP,
+                        int>::type>
+fn::details::Estimate View<C, E, R, P, F, t>::explain(std::string* plan,
+                                                      size_t depth) const {
+  std::string parent_plan;
+  const auto first = parent_.first.explain(&parent_plan, depth + 1);
+  const auto second = parent_.second.explain(&parent_plan, depth + 1);
+  const auto rows = fn::details::estimate_zip(first, second);
+  *plan += std::string(2 * depth, ' ') + "ZIP (" + rows.to_string() +
+           "): warning: the left side is materialized\n" + parent_plan;
+  return rows;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G,
+          typename std::enable_if<
+              sizeof(G) && !std::is_same<void*, P>::value &&
+                  t == fn::details::FuncType::FILTER &&
+                  fn::details::is_batched_stage<P, F>::value,
+              int>::type>
+void View<C, E, R, P, F, t>::do_evaluate(G g) const {
+  const auto& c = *parent_.container_;
+  if (!func_.safe()) {
+    for (const auto& e : c) {
+      if (func_(e)) {
+        g(e);
+      }
+    }
+    return;
+  }
+
+  fn::details::filter_batched(c.data(), c.size(), func_, g);
+}
+
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
@@ -363,7 +880,11 @@ template <typename G,
                                       t == fn::details::FuncType::ZIP,
                                   int>::type>
 void View<C, E, R, P, F, t>::do_evaluate(G g) const {
-  auto p1 = parent_.first.evaluate();
+  // The left side is materialized, using the arena of the current scope if
+  // there is one.
+  using P1E = typename std::decay<typename P::first_type::Element>::type;
+  ArenaVector<P1E> p1;
+  parent_.first.evaluate(&p1);
   auto itr = p1.begin();
   auto end = p1.end();
 
@@ -428,15 +949,38 @@ template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
 template <typename G,
-          typename std::enable_if<sizeof(G) && !std::is_same<void*, P>::value &&
-                                      t == fn::details::FuncType::MAP,
-                                  int>::type>
+          typename std::enable_if<
+              sizeof(G) && !std::is_same<void*, P>::value &&
+                  t == fn::details::FuncType::MAP &&
+                  !fn::details::is_batched_stage<P, F>::value,
+              int>::type>
 void View<C, E, R, P, F, t>::do_evaluate(G g) const {
   using PE = typename std::decay<typename P::Element>::type;
 
   parent_.do_evaluate([this, &g](const PE& e) { g(func_(e)); });
 }
 
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G,
+          typename std::enable_if<
+              sizeof(G) && !std::is_same<void*, P>::value &&
+                  t == fn::details::FuncType::MAP &&
+                  fn::details::is_batched_stage<P, F>::value,
+              int>::type>
+void View<C, E, R, P, F, t>::do_evaluate(G g) const {
+  const auto& c = *parent_.container_;
+  if (!func_.safe()) {
+    for (const auto& e : c) {
+      g(func_(e));
+    }
+    return;
+  }
+
+  fn::details::map_batched(c.data(), c.size(), func_, g);
+}
+
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
@@ -447,11 +991,67 @@ template <typename G,
 void View<C, E, R, P, F, t>::do_evaluate(G g) const {
   using PE = typename std::decay<typename P::Element>::type;
 
+  parent_.do_evaluate([this, &g](const PE& e) { for_each_inner(func_(e), g); });
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename I, typename G>
+void View<C, E, R, P, F, t>::for_each_inner(const I& inner, G& g) {
+  for (const auto& i : inner) {
+    g(i);
+  }
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename It, typename G>
+void View<C, E, R, P, F, t>::for_each_inner(const std::pair<It, It>& inner,
+                                            G& g) {
+  for (auto i = inner.first; i != inner.second; ++i) {
+    g(*i);
+  }
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G>
+void View<C, E, R, P, F, t>::for_each_inner(const Tokens& inner, G& g) {
+  inner.for_each(g);
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <template <typename...> class C2, typename E2,  // clang-format.
+          template <typename...> class R2, typename P2, typename F2,
+          fn::details::FuncType t2, typename G>
+void View<C, E, R, P, F, t>::for_each_inner(
+    const View<C2, E2, R2, P2, F2, t2>& inner, G& g) {
+  // Evaluating the inner view directly is much cheaper than iterating it.
+  inner.do_evaluate([&g](const E2& e) { g(e); });
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G,
+          typename std::enable_if<sizeof(G) && !std::is_same<void*, P>::value &&
+                                      t == fn::details::FuncType::MAP_FILTER,
+                                  int>::type>
+void View<C, E, R, P, F, t>::do_evaluate(G g) const {
+  using PE = typename std::decay<typename P::Element>::type;
+
   parent_.do_evaluate([this, &g](const PE& e) {
-    const auto& r = func_(e);
-    for (const auto& i : r) {
-      g(i);
+    const auto& m = func_.map(e);
+    if (!func_.pred(m)) {
+      return;
     }
+
+    g(m);
   });
 }
 
@@ -468,6 +1068,21 @@ void View<C, E, R, P, F, t>::do_evaluate(G g) const {
   parent_.do_evaluate([this, &g](const PE& e) { g(func_(e)); });
 }
 
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G,
+          typename std::enable_if<sizeof(G) && !std::is_same<void*, P>::value &&
+                                      t == fn::details::FuncType::PROBE,
+                                  int>::type>
+void View<C, E, R, P, F, t>::do_evaluate(G g) const {
+  using PE = typename std::decay<typename P::Element>::type;
+
+  fn::details::ProbeRun<G> run(func_, &g);
+  parent_.do_evaluate([&run](const PE& e) { run(e); });
+  run.finish(fn::details::first_stage_input(parent_));
+}
+
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
@@ -478,7 +1093,7 @@ C<E> View<C, E, R, P, F, t>::evaluate() const {
 
   C<E> c;
   do_evaluate([&c](const E& e) { c.push_back(e); });
-  return std::move(c);
+  return c;
 }
 
 template <template <typename...> class C, typename E,  // clang-format.
@@ -487,7 +1102,16 @@ template <template <typename...> class C, typename E,  // clang-format.
 std::vector<E> View<C, E, R, P, F, t>::as_vector() const {
   std::vector<E> v;
   do_evaluate([&](const E& e) { v.push_back(e); });
-  return std::move(v);
+  return v;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+ArenaVector<E> View<C, E, R, P, F, t>::as_vector(Arena* arena) const {
+  ArenaVector<E> v{ArenaAllocator<E>(arena)};
+  evaluate(&v);
+  return v;
 }
 
 template <template <typename...> class C, typename E,  // clang-format.
@@ -496,7 +1120,16 @@ template <template <typename...> class C, typename E,  // clang-format.
 std::list<E> View<C, E, R, P, F, t>::as_list() const {
   std::list<E> l;
   evaluate(&l);
-  return std::move(l);
+  return l;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+ArenaList<E> View<C, E, R, P, F, t>::as_list(Arena* arena) const {
+  ArenaList<E> l{ArenaAllocator<E>(arena)};
+  evaluate(&l);
+  return l;
 }
 
 template <template <typename...> class C, typename E,  // clang-format.
@@ -505,7 +1138,16 @@ template <template <typename...> class C, typename E,  // clang-format.
 std::deque<E> View<C, E, R, P, F, t>::as_deque() const {
   std::deque<E> d;
   evaluate(&d);
-  return std::move(d);
+  return d;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+ArenaDeque<E> View<C, E, R, P, F, t>::as_deque(Arena* arena) const {
+  ArenaDeque<E> d{ArenaAllocator<E>(arena)};
+  evaluate(&d);
+  return d;
 }
 
 template <template <typename...> class C, typename E,  // clang-format.
@@ -514,7 +1156,106 @@ template <template <typename...> class C, typename E,  // clang-format.
 std::unordered_set<E> View<C, E, R, P, F, t>::as_set() const {
   std::unordered_set<E> set;
   evaluate(&set);
-  return std::move(set);
+  return set;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+ArenaSet<E> View<C, E, R, P, F, t>::as_set(Arena* arena) const {
+  ArenaSet<E> set(0, std::hash<E>(), std::equal_to<E>(),
+                  ArenaAllocator<E>(arena));
+  evaluate(&set);
+  return set;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+View<C, E, fn::details::SortedCopy> View<C, E, R, P, F, t>::sort() const {
+  C<E> c = evaluate();
+  fn::details::sort(&c, std::less<E>());
+  return View<C, E, fn::details::SortedCopy>(std::move(c),
+                                             fn::details::Private());
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename Cmp>
+View<C, E> View<C, E, R, P, F, t>::sort(Cmp cmp) const {
+  C<E> c = evaluate();
+  fn::details::sort(&c, cmp);
+  return View<C, E>(std::move(c), fn::details::Private());
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename Cmp>
+View<SortedRuns, E> View<C, E, R, P, F, t>::external_sort(size_t memory,
+                                                          Cmp cmp) const {
+  fn::details::ExternalSorter<E, Cmp> sorter(memory, cmp);
+  do_evaluate([&sorter](const E& e) { sorter(e); });
+  return View<SortedRuns, E>(sorter.finish(), fn::details::Private());
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename Eq,
+          typename std::enable_if<
+              sizeof(Eq) && fn::details::is_sorted_view<R, P, t>::value,
+              int>::type>
+C<E> View<C, E, R, P, F, t>::distinct(Eq eq) const {
+  C<E> c;
+  bool first = true;
+  E prev{};
+  do_evaluate([&](const E& e) {
+    if (!first && eq(prev, e)) {
+      return;
+    }
+
+    fn::details::append(&c, e);
+    prev = e;
+    first = false;
+  });
+  return c;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename Eq,
+          typename std::enable_if<
+              sizeof(Eq) && !fn::details::is_sorted_view<R, P, t>::value &&
+                  std::is_same<Eq, std::equal_to<E>>::value,
+              int>::type>
+C<E> View<C, E, R, P, F, t>::distinct(Eq eq) const {
+  return sort().distinct(eq);
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename Eq,
+          typename std::enable_if<
+              sizeof(Eq) && !fn::details::is_sorted_view<R, P, t>::value &&
+                  !std::is_same<Eq, std::equal_to<E>>::value,
+              int>::type>
+C<E> View<C, E, R, P, F, t>::distinct(Eq eq) const {
+  // Sorting with < would not put the values equal under eq next to each other.
+  C<E> c;
+  do_evaluate([&](const E& e) {
+    for (const auto& d : c) {
+      if (eq(d, e)) {
+        return;
+      }
+    }
+
+    fn::details::append(&c, e);
+  });
+  return c;
 }
 
 template <template <typename...> class C, typename E,  // clang-format.
@@ -526,24 +1267,72 @@ template <typename K, typename V,
 std::unordered_map<K, V> View<C, E, R, P, F, t>::as_map() const {
   std::unordered_map<K, V> m;
   evaluate(&m);
-  return std::move(m);
+  return m;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename K, typename V,
+          typename std::enable_if<sizeof(K) && fn::details::is_pair<E>::value,
+                                  int>::type>
+ArenaMap<K, V> View<C, E, R, P, F, t>::as_map(Arena* arena) const {
+  ArenaMap<K, V> m(0, std::hash<K>(), std::equal_to<K>(),
+                   ArenaAllocator<std::pair<const K, V>>(arena));
+  evaluate(&m);
+  return m;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G, typename K>
+std::unordered_map<K, size_t> View<C, E, R, P, F, t>::count_by(G g) const {
+  std::unordered_map<K, size_t> counts;
+  do_evaluate([&](const E& e) { counts[g(e)]++; });
+  return counts;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+std::unordered_map<E, size_t> View<C, E, R, P, F, t>::count_by() const {
+  std::unordered_map<E, size_t> counts;
+  do_evaluate([&counts](const E& e) { counts[e]++; });
+  return counts;
+}
+
+template <template <typename...> class C, typename E,  // clang-format.
+          template <typename...> class R, typename P, typename F,
+          fn::details::FuncType t>
+template <typename G, typename T,
+          typename std::enable_if<sizeof(T) && fn::details::is_pair<E>::value,
+                                  int>::type>
+View<Groups, E> View<C, E, R, P, F, t>::external_reduce_by(size_t memory,
+                                                           G reduce) const {
+  using K = typename std::decay<typename E::first_type>::type;
+  using V = typename std::decay<typename E::second_type>::type;
+
+  fn::details::ExternalReducer<K, V, G> reducer(memory, reduce);
+  do_evaluate([&reducer](const E& e) { reducer(e); });
+  return View<Groups, E>(reducer.finish(), fn::details::Private());
 }
 
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
-template <template <typename...> class EC>
-void View<C, E, R, P, F, t>::evaluate(EC<E>* c) const {
+template <template <typename...> class EC, typename... A>
+void View<C, E, R, P, F, t>::evaluate(EC<E, A...>* c) const {
   assert(c != nullptr && "Container is nullptr.");
-  do_evaluate([&](const E& e) { c->push_back(e); });
+  do_evaluate([&](const E& e) { fn::details::append(c, e); });
 }
 
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
-template <template <typename...> class EC>
+template <template <typename...> class EC, typename... A>
 const View<C, E, R, P, F, t>& View<C, E, R, P, F, t>::operator>>(
-    EC<E>* container) const {
+    EC<E, A...>* container) const {
   evaluate(container);
   return *this;
 }
@@ -551,10 +1340,11 @@ const View<C, E, R, P, F, t>& View<C, E, R, P, F, t>::operator>>(
 template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
-template <typename K, typename V,
+template <typename K, typename V, typename... A,
           typename std::enable_if<sizeof(K) && fn::details::is_pair<E>::value,
                                   int>::type>
-void View<C, E, R, P, F, t>::evaluate(std::unordered_map<K, V>* m) const {
+void View<C, E, R, P, F, t>::evaluate(
+    std::unordered_map<K, V, A...>* m) const {
   static_assert(std::is_convertible<typename E::first_type, K>::value,
                 "Cannot use K for key.");
   static_assert(std::is_convertible<typename E::second_type, V>::value,
@@ -566,7 +1356,7 @@ template <template <typename...> class C, typename E,  // clang-format.
           template <typename...> class R, typename P, typename F,
           fn::details::FuncType t>
 View<C, E, R, P, F, t>::operator C<E>() const {
-  return std::move(evaluate());
+  return evaluate();
 }
 
 template <template <typename...> class C, typename E>
@@ -594,6 +1384,49 @@ View<std::vector, std::pair<K, V>> _(const std::unordered_map<K, V>& l) {
   return _(std::vector<std::pair<K, V>>(l.begin(), l.end()));
 }
 
+template <template <typename...> class C, typename E>
+View<C, E, fn::details::SortedCopy> _(fn::details::Sorted<C<E>> s) {
+  return View<C, E, fn::details::SortedCopy>(std::move(s.c),
+                                             fn::details::Private());
+}
+
+template <template <typename...> class C, typename E>
+View<C, E, fn::details::SortedRef> _(fn::details::Sorted<const C<E>*> s) {
+  return View<C, E, fn::details::SortedRef>(*s.c, fn::details::Private());
+}
+
+template <template <typename...> class C, typename E>
+fn::details::Sorted<C<E>> sorted(C<E>&& c) {
+  assert(std::is_sorted(c.begin(), c.end()) && "Container is not sorted.");
+  return fn::details::Sorted<C<E>>{std::move(c)};
+}
+
+template <template <typename...> class C, typename E>
+fn::details::Sorted<C<E>> sorted(const C<E>& c) {
+  assert(std::is_sorted(c.begin(), c.end()) && "Container is not sorted.");
+  return fn::details::Sorted<C<E>>{c};
+}
+
+template <template <typename...> class C, typename E>
+fn::details::Sorted<const C<E>*> sorted(const C<E>* c) {
+  assert(c != nullptr && "Container is nullptr.");
+  assert(std::is_sorted(c->begin(), c->end()) && "Container is not sorted.");
+  return fn::details::Sorted<const C<E>*>{c};
+}
+
+template <typename T>
+fn::details::Between<T> between(const T& lo, const T& hi) {
+  return fn::details::Between<T>(lo, hi);
+}
+
+template <template <typename...> class C, typename E>
+View<Span, E> _(const C<E>& c, Arena* arena) {
+  assert(arena != nullptr && "Arena is nullptr.");
+  size_t size = 0;
+  auto data = arena->copy<E>(c.begin(), c.end(), &size);
+  return _(Span<E>(data, size));
+}
+
 }  // namespace fn
 
 #endif  // FUNC_FUNC_INL_H_
@@ -21,14 +21,31 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <string>
 #include <type_traits>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 
+#include "fn/adaptive.h"
+#include "fn/arena.h"
+#include "fn/async.h"
+#include "fn/bitmap.h"
+#include "fn/columns.h"
 #include "fn/details.h"
+#include "fn/explain.h"
+#include "fn/expr.h"
+#include "fn/external.h"
+#include "fn/packed.h"
+#include "fn/patterns.h"
+#include "fn/profile.h"
 #include "fn/range.h"
+#include "fn/sink.h"
+#include "fn/small_vector.h"
+#include "fn/span.h"
+#include "fn/string_view.h"
+#include "fn/tokens.h"
 
 namespace fn {
 
@@ -60,13 +77,25 @@ class View {
   using Container = C<E>;
   using CPtr = R<C<E>>;
   using PView = P;
+  using Func = F;
+
+  // A view on the same root with a different stage.
+  template <typename E2, typename P2, typename F2, fn::details::FuncType t2>
+  using Rebind = View<C, E2, R, P2, F2, t2>;
+
+  // A root view on a different container.
+  template <template <typename...> class C2, typename E2>
+  using Root = View<C2, E2>;
 
   template <typename G>
-  using FView = View<C, E, R, View, G>;
+  using FView = typename fn::details::FilterFusion<
+      View, G, t, std::is_same<void*, P>::value ||
+                      fn::details::is_slice_filter<View, G>::value>::type;
 
   template <typename MP, typename G>
-  using MView = View<C, typename std::decay<MP>::type, R, View, G,
-                     fn::details::FuncType::MAP>;
+  using MView =
+      typename fn::details::MapFusion<View, typename std::decay<MP>::type, G,
+                                      t, std::is_same<void*, P>::value>::type;
 
   using Iterator = fn::details::ViewIterator<View, PView, t>;
 
@@ -77,6 +106,13 @@ class View {
 
   static const fn::details::FuncType func_type = t;
 
+  // Whether the elements of this view are known to be sorted by operator<.
+  static const bool sorted = fn::details::is_sorted_view<R, P, t>::value;
+
+  // Whether this view can evaluate the elements in a range of values using a
+  // binary search on its root.
+  static const bool sliceable = fn::details::is_sliceable_view<R, P, t>::value;
+
   // Use fn::_ instead. These constructors are not technically public.
   View(const C<E>& c, fn::details::Private);
   View(C<E>&& c, fn::details::Private);
@@ -92,18 +128,131 @@ class View {
 
   ~View() {}
 
-  // Filters the content of this view using the given function.
-  template <typename G>
+  // Filters the content of this view using the given function. Filtering a
+  // filter or a map does not add a new stage: the predicates are fused into
+  // the current stage instead. On sorted views, range filters (see
+  // fn::between()) get a stage of their own and are evaluated using a binary
+  // search.
+  template <typename G,
+            typename std::enable_if<
+                sizeof(G) && (std::is_same<void*, P>::value ||
+                              (t != fn::details::FuncType::FILTER &&
+                               t != fn::details::FuncType::MAP &&
+                               t != fn::details::FuncType::MAP_FILTER) ||
+                              fn::details::is_slice_filter<View, G>::value),
+                int>::type = 0>
   FView<G> filter(G g) const;
 
-  // Maps the content of this view using the given function.
-  template <typename G>
-  auto map(G g) -> MView<decltype(g(*(E*) nullptr)), G> const;
+  template <typename G, typename std::enable_if<
+                            sizeof(G) && !std::is_same<void*, P>::value &&
+                                t == fn::details::FuncType::FILTER &&
+                                !fn::details::is_slice_filter<View, G>::value,
+                            int>::type = 0>
+  FView<G> filter(G g) const;
+
+  template <typename G, typename std::enable_if<
+                            sizeof(G) && !std::is_same<void*, P>::value &&
+                                t == fn::details::FuncType::MAP,
+                            int>::type = 0>
+  FView<G> filter(G g) const;
+
+  template <typename G, typename std::enable_if<
+                            sizeof(G) && !std::is_same<void*, P>::value &&
+                                t == fn::details::FuncType::MAP_FILTER,
+                            int>::type = 0>
+  FView<G> filter(G g) const;
+
+  // Filters the strings of this view containing any of the given patterns,
+  // using an automaton compiled once (see fn::contains_any()).
+  FView<ContainsAny> filter_contains_any(
+      const std::vector<std::string>& patterns) const;
+
+  // Evaluates this filter stage using bitmaps. On a contiguous root, elements
+  // are filtered in blocks: the first predicate sets one bit per element, and
+  // the predicates fused after it are only evaluated for the bits still set.
+  // The following stages only visit the set bits, and size() counts them.
+  // Predicates are evaluated for a whole block before the elements are passed
+  // on, so it is opt-in.
+  template <typename T = int, typename std::enable_if<
+                                  sizeof(T) && !std::is_same<void*, P>::value &&
+                                      t == fn::details::FuncType::FILTER,
+                                  int>::type = 0>
+  View<C, E, R, P, fn::details::BitmapFilter<F>> bitmap() const;
+
+  // Reorders the predicates of this filter stage at run time, so that those
+  // rejecting the most elements per nanosecond are evaluated first. The pass
+  // rate and cost of each predicate are sampled on the first elements, and
+  // periodically after that. While sampling, all predicates are evaluated for
+  // each element, so the predicates must be independent and free of side
+  // effects. Iterators evaluate the predicates in their original order.
+  template <typename T = int, typename std::enable_if<
+                                  sizeof(T) && !std::is_same<void*, P>::value &&
+                                      t == fn::details::FuncType::FILTER,
+                                  int>::type = 0>
+  View<C, E, R, P, fn::details::AdaptiveFilter<F>> adaptive() const;
+
+  // Returns a copy of this view with a probe after each stage, which reports
+  // the elements and the time spent in the stage to report (see fn::Profile).
+  // Only the returned view is instrumented.
+  template <typename V = View>
+  typename fn::details::Probed<V>::type profile(Profile* report) const;
+
+  // Returns the plan of this view: one line per stage, starting from the last
+  // one, with the parents of each stage indented under it:
+  //
+  //   MAP (rows <= 1000)
+  //     FILTER (rows <= 1000)
+  //       root std::vector<int> by Ref (rows = 1000)
+  //
+  // Each line shows an estimate of the number of elements of the stage, and
+  // how it is evaluated. Costly patterns are flagged with "warning:".
+  std::string explain() const;
+
+  // Maps the content of this view using the given function. Mapping a map
+  // does not add a new stage: the functions are composed instead. Mapping
+  // columns to one of their columns results in a view on that column.
+  template <typename G,
+            typename std::enable_if<
+                sizeof(G) &&
+                    ((std::is_same<void*, P>::value &&
+                      !fn::details::is_column_projection<C<E>, G>::value) ||
+                     (!std::is_same<void*, P>::value &&
+                      t != fn::details::FuncType::MAP)),
+                int>::type = 0>
+  auto map(G g) const -> MView<decltype(g(*(E*) nullptr)), G>;
+
+  template <typename G,
+            typename std::enable_if<
+                sizeof(G) && std::is_same<void*, P>::value &&
+                    fn::details::is_column_projection<C<E>, G>::value,
+                int>::type = 0>
+  auto map(G g) const -> MView<decltype(g(*(E*) nullptr)), G>;
 
+  template <typename G, typename std::enable_if<
+                            sizeof(G) && !std::is_same<void*, P>::value &&
+                                t == fn::details::FuncType::MAP,
+                            int>::type = 0>
+  auto map(G g) const -> MView<decltype(g(*(E*) nullptr)), G>;
+
+  // Maps each element to a collection using the given function, and flattens
+  // the results. The function can return a container, a view, or a pair of
+  // iterators. Inner views and iterator pairs are iterated in place, without
+  // materializing them. Since those may refer to the element they were made
+  // from, copying an iterator calls the function again when the elements are
+  // temporaries (e.g., after a map); containers are copied instead.
   template <typename G>
-  auto flat_map(G g)
-      -> View<C, typename decltype(g(*(E*) nullptr))::value_type, R, View, G,
-              fn::details::FuncType::FLAT_MAP> const;
+  auto flat_map(G g) const -> View<
+      C, typename fn::details::inner_element<typename std::decay<decltype(
+             g(*(E*) nullptr))>::type>::type,
+      R, View, G, fn::details::FuncType::FLAT_MAP>;
+
+  // Splits each string of this view into its tokens: the non-empty substrings
+  // separated by any of the given delimiter bytes. Tokens are StringViews into
+  // the strings, so nothing is allocated, and the strings must outlive them.
+  // Sets of up to 8 delimiters are found using SIMD instructions.
+  View<C, StringView, R, View, fn::details::Tokenizer,
+       fn::details::FuncType::FLAT_MAP>
+  split(StringView delims = " \t\r\n") const;
 
   // Folds the content of this view from left. Uses the given initial value.
   template <typename T, typename G>
@@ -117,6 +266,11 @@ class View {
   template <typename G>
   void for_each(G g) const;
 
+  // Writes the bytes of the elements, which must be trivially copyable, to the
+  // file at path, created or truncated. Throws std::system_error on failure.
+  void to_file(const std::string& path,
+               WriteMode mode = WriteMode::BUFFERED) const;
+
   // Skips element until g returns true.
   template <typename G>
   View<C, E, R, View, G, fn::details::FuncType::SKIP> skip_until(G g) const;
@@ -125,6 +279,21 @@ class View {
   template <typename G>
   View<C, E, R, View, G, fn::details::FuncType::KEEP> keep_while(G g) const;
 
+  // Returns a root view on the elements of this view evaluated on a thread of
+  // its own, so that the stages before and after it run in parallel:
+  //
+  //   auto totals = _(fn::read_lines())
+  //                     .map(parse)
+  //                     .async()
+  //                     .filter(is_valid)
+  //                     .count_by(user_of);
+  //
+  // Elements are handed over in batches through a bounded queue, so a slow
+  // consumer blocks the producer. Exceptions thrown before the boundary are
+  // rethrown after it, and stopping after it stops the thread. Every
+  // evaluation evaluates this view again, on a new thread.
+  View<Async, E> async() const;
+
   // Zips this view with another view.
   template <template <typename...> class C2, typename E2, template <typename...>
             class R2, typename P2, typename F2, fn::details::FuncType t2>
@@ -142,18 +311,61 @@ class View {
   // Returns the first element in the view.
   E first() const;
 
-  // Returns the last element in the view.
+  // Returns the last element in the view. Constant time on sorted roots.
+  template <typename T = int,
+            typename std::enable_if<
+                sizeof(T) && (!std::is_same<void*, P>::value ||
+                              !fn::details::is_sorted_view<R, P, t>::value),
+                int>::type = 0>
+  E last() const;
+
+  template <typename T = int,
+            typename std::enable_if<
+                sizeof(T) && std::is_same<void*, P>::value &&
+                    fn::details::is_sorted_view<R, P, t>::value,
+                int>::type = 0>
   E last() const;
 
   // Returns the minimum element in the view. Assumes that operator< is defined
-  // for E.
+  // for E. On sorted views, this is the first element.
+  template <typename T = int,
+            typename std::enable_if<
+                sizeof(T) && !fn::details::is_sorted_view<R, P, t>::value,
+                int>::type = 0>
+  E min() const;
+
+  template <typename T = int,
+            typename std::enable_if<
+                sizeof(T) && fn::details::is_sorted_view<R, P, t>::value,
+                int>::type = 0>
   E min() const;
 
   // Returns the maximum element in the view. Assumes that operator< is defined
-  // for E.
+  // for E. On sorted views, this is the last element.
+  template <typename T = int,
+            typename std::enable_if<
+                sizeof(T) && !fn::details::is_sorted_view<R, P, t>::value,
+                int>::type = 0>
   E max() const;
 
-  // Returns the number of elements in the view.
+  template <typename T = int,
+            typename std::enable_if<
+                sizeof(T) && fn::details::is_sorted_view<R, P, t>::value,
+                int>::type = 0>
+  E max() const;
+
+  // Returns the number of elements in the view. Bitmap filters on contiguous
+  // roots count the bits set.
+  template <typename T = int,
+            typename std::enable_if<
+                sizeof(T) && !fn::details::is_bitmap_stage<P, F>::value,
+                int>::type = 0>
+  size_t size() const;
+
+  template <typename T = int,
+            typename std::enable_if<
+                sizeof(T) && fn::details::is_bitmap_stage<P, F>::value,
+                int>::type = 0>
   size_t size() const;
 
   // Returns the size of the container (ie, source) stored in the root view.
@@ -182,27 +394,64 @@ class View {
 
   // Returns the values in the view as a vector.
   std::vector<E> as_vector() const;
+  ArenaVector<E> as_vector(Arena* arena) const;
 
   // Returns the values in the view as a list.
   std::list<E> as_list() const;
+  ArenaList<E> as_list(Arena* arena) const;
 
   // Returns the values in the view as a deque.
   std::deque<E> as_deque() const;
+  ArenaDeque<E> as_deque(Arena* arena) const;
 
   // Returns the values as a set.
   // Note: This is different than distinct(). Here we simply insert elements
   // into unordered_set, but in disctinct() we use std::unique. They have
   // different performance implications.
   std::unordered_set<E> as_set() const;
+  ArenaSet<E> as_set(Arena* arena) const;
 
-  // Returns the values in a sorted order using c as the comparator.
-  template <typename Cmp>
-  C<E> sort(Cmp c = std::less<E>()) const;
+  // Returns a root view on the values in a sorted order. Sorting using
+  // operator< results in a sorted view, as if created by fn::sorted().
+  View<C, E, fn::details::SortedCopy> sort() const;
 
-  // Returns distinct values using eq as the equality function.
+  template <typename Cmp>
+  View<C, E> sort(Cmp cmp) const;
+
+  // Sorts the values using cmp, for values that may not fit in memory: runs of
+  // at most memory bytes are sorted in memory and spilled to temporary files,
+  // which are merged lazily as the returned view is evaluated. Elements must be
+  // trivially copyable.
+  // Note: memory bounds the run buffer, which is allocated once. Spills are
+  // written from it directly, and the spilled runs are mapped back in memory,
+  // where the kernel pages them in and out.
+  template <typename Cmp = std::less<E>>
+  View<SortedRuns, E> external_sort(size_t memory, Cmp cmp = Cmp()) const;
+
+  // Returns distinct values using eq as the equality function. Sorted views
+  // are deduplicated in one pass over adjacent values. Other views are sorted
+  // first when eq is std::equal_to, and otherwise each value is compared with
+  // the distinct values found before it, which are returned in their order.
   // Note: See as_set().
-  template <typename Eq>
-  C<E> distinct(Eq eq = std::equal_to<E>()) const;
+  template <typename Eq = std::equal_to<E>,
+            typename std::enable_if<
+                sizeof(Eq) && fn::details::is_sorted_view<R, P, t>::value,
+                int>::type = 0>
+  C<E> distinct(Eq eq = Eq()) const;
+
+  template <typename Eq = std::equal_to<E>,
+            typename std::enable_if<
+                sizeof(Eq) && !fn::details::is_sorted_view<R, P, t>::value &&
+                    std::is_same<Eq, std::equal_to<E>>::value,
+                int>::type = 0>
+  C<E> distinct(Eq eq = Eq()) const;
+
+  template <typename Eq = std::equal_to<E>,
+            typename std::enable_if<
+                sizeof(Eq) && !fn::details::is_sorted_view<R, P, t>::value &&
+                    !std::is_same<Eq, std::equal_to<E>>::value,
+                int>::type = 0>
+  C<E> distinct(Eq eq = Eq()) const;
 
   // Returns the values in the view as a map.
   template <typename K, typename V,
@@ -210,19 +459,49 @@ class View {
                 sizeof(K) && fn::details::is_pair<E>::value, int>::type = 0>
   std::unordered_map<K, V> as_map() const;
 
+  template <typename K, typename V,
+            typename std::enable_if<
+                sizeof(K) && fn::details::is_pair<E>::value, int>::type = 0>
+  ArenaMap<K, V> as_map(Arena* arena) const;
+
+  // Returns the number of elements for each key returned by g, or for each
+  // distinct element.
+  template <typename G, typename K = typename std::decay<
+                            decltype(std::declval<G>()(*(E*) nullptr))>::type>
+  std::unordered_map<K, size_t> count_by(G g) const;
+
+  std::unordered_map<E, size_t> count_by() const;
+
+  // Reduces the values of the pairs with the same key using reduce, for keys
+  // that may not fit in memory: the groups are reduced in a hash map of at
+  // most about memory bytes, spilled to temporary files by partitions of the
+  // keys whenever full. The partitions are reduced one at a time as the
+  // returned view is evaluated. Keys and values must be trivially copyable.
+  // Note: memory bounds the hash map, and the one a partition is reduced in.
+  // A spill also copies the entries of the map, to sort them by partition.
+  //
+  //   auto clicks = _(events).map([](const Event& e) {
+  //                             return std::make_pair(e.user, 1L);
+  //                           })
+  //                     .external_reduce_by(4L << 30, std::plus<long>());
+  template <typename G, typename T = int,
+            typename std::enable_if<
+                sizeof(T) && fn::details::is_pair<E>::value, int>::type = 0>
+  View<Groups, E> external_reduce_by(size_t memory, G reduce) const;
+
   // Evaluates the view and append the entreies to c.
-  template <template <typename...> class EC>
-  void evaluate(EC<E>* c) const;
+  template <template <typename...> class EC, typename... A>
+  void evaluate(EC<E, A...>* c) const;
 
   // Evaluates the view and insert the pais in a map.
-  template <typename K, typename V,
+  template <typename K, typename V, typename... A,
             typename std::enable_if<
                 sizeof(K) && fn::details::is_pair<E>::value, int>::type = 0>
-  void evaluate(std::unordered_map<K, V>* m) const;
+  void evaluate(std::unordered_map<K, V, A...>* m) const;
 
   // Syntactic sugar for map().
   template <typename G>
-  auto operator*(G g) -> MView<decltype(g(*(E*) nullptr)), G> const;
+  auto operator*(G g) const -> MView<decltype(g(*(E*) nullptr)), G>;
 
   // Syntactic sugar for filter().
   template <typename G>
@@ -237,8 +516,8 @@ class View {
   const View& operator>>(G g) const;
 
   // Syntactic sugar for in-place evaluate.
-  template <template <typename...> class EC>
-  const View& operator>>(EC<E>* container) const;
+  template <template <typename...> class EC, typename... A>
+  const View& operator>>(EC<E, A...>* container) const;
 
   template <template <typename...> class C2, typename E2, template <typename...>
             class R2, typename P2, typename F2, fn::details::FuncType t2>
@@ -272,9 +551,57 @@ class View {
                                     int>::type = 0>
   void do_evaluate(G g) const;
 
+  template <typename G,
+            typename std::enable_if<
+                sizeof(G) && !std::is_same<void*, P>::value &&
+                    t == fn::details::FuncType::FILTER &&
+                    !fn::details::is_batched_stage<P, F>::value &&
+                    !fn::details::is_bitmap_stage<P, F>::value &&
+                    !fn::details::is_adaptive_filter<F>::value &&
+                    !fn::details::is_block_range_stage<P, F>::value &&
+                    !(fn::details::is_range_filter<F>::value &&
+                      fn::details::is_sliceable_view<R, P, t>::value),
+                int>::type = 0>
+  void do_evaluate(G g) const;
+
+  template <typename G, typename std::enable_if<
+                            sizeof(G) && !std::is_same<void*, P>::value &&
+                                t == fn::details::FuncType::FILTER &&
+                                fn::details::is_adaptive_filter<F>::value,
+                            int>::type = 0>
+  void do_evaluate(G g) const;
+
+  // Bitmap filters on contiguous roots only visit the set bits.
+  template <typename G, typename std::enable_if<
+                            sizeof(G) && !std::is_same<void*, P>::value &&
+                                t == fn::details::FuncType::FILTER &&
+                                fn::details::is_bitmap_stage<P, F>::value,
+                            int>::type = 0>
+  void do_evaluate(G g) const;
+
+  // Range filters on sliceable views only visit the elements in the range.
+  template <typename G, typename std::enable_if<
+                            sizeof(G) && !std::is_same<void*, P>::value &&
+                                t == fn::details::FuncType::FILTER &&
+                                fn::details::is_range_filter<F>::value &&
+                                fn::details::is_sliceable_view<R, P, t>::value,
+                            int>::type = 0>
+  void do_evaluate(G g) const;
+
+  // Range filters on packed columns skip the blocks outside of the range.
+  template <typename G,
+            typename std::enable_if<
+                sizeof(G) && !std::is_same<void*, P>::value &&
+                    t == fn::details::FuncType::FILTER &&
+                    fn::details::is_block_range_stage<P, F>::value,
+                int>::type = 0>
+  void do_evaluate(G g) const;
+
+  // Expressions on contiguous roots are evaluated in batches.
   template <typename G, typename std::enable_if<
                             sizeof(G) && !std::is_same<void*, P>::value &&
-                                t == fn::details::FuncType::FILTER,
+                                t == fn::details::FuncType::FILTER &&
+                                fn::details::is_batched_stage<P, F>::value,
                             int>::type = 0>
   void do_evaluate(G g) const;
 
@@ -298,7 +625,16 @@ class View {
 
   template <typename G, typename std::enable_if<
                             sizeof(G) && !std::is_same<void*, P>::value &&
-                                t == fn::details::FuncType::MAP,
+                                t == fn::details::FuncType::MAP &&
+                                !fn::details::is_batched_stage<P, F>::value,
+                            int>::type = 0>
+  void do_evaluate(G g) const;
+
+  // Expressions on contiguous roots are evaluated in batches.
+  template <typename G, typename std::enable_if<
+                            sizeof(G) && !std::is_same<void*, P>::value &&
+                                t == fn::details::FuncType::MAP &&
+                                fn::details::is_batched_stage<P, F>::value,
                             int>::type = 0>
   void do_evaluate(G g) const;
 
@@ -308,12 +644,102 @@ class View {
                             int>::type = 0>
   void do_evaluate(G g) const;
 
+  template <typename G, typename std::enable_if<
+                            sizeof(G) && !std::is_same<void*, P>::value &&
+                                t == fn::details::FuncType::MAP_FILTER,
+                            int>::type = 0>
+  void do_evaluate(G g) const;
+
   template <typename G, typename std::enable_if<
                             sizeof(G) && !std::is_same<void*, P>::value &&
                                 t == fn::details::FuncType::FOLD_LEFT,
                             int>::type = 0>
   void do_evaluate(G g) const;
 
+  // Probes count the elements of their parent, and time the following stages.
+  template <typename G, typename std::enable_if<
+                            sizeof(G) && !std::is_same<void*, P>::value &&
+                                t == fn::details::FuncType::PROBE,
+                            int>::type = 0>
+  void do_evaluate(G g) const;
+
+  // Calls g for the elements of a sliceable view that fall in the range of the
+  // range filter b.
+  template <typename B, typename G,
+            typename std::enable_if<sizeof(G) && std::is_same<void*, P>::value,
+                                    int>::type = 0>
+  void do_evaluate_slice(const B& b, G g) const;
+
+  template <typename B, typename G, typename std::enable_if<
+                                        sizeof(G) &&
+                                            !std::is_same<void*, P>::value &&
+                                            t == fn::details::FuncType::FILTER,
+                                        int>::type = 0>
+  void do_evaluate_slice(const B& b, G g) const;
+  template <typename B, typename G, typename std::enable_if<
+                                        sizeof(G) &&
+                                            !std::is_same<void*, P>::value &&
+                                            t == fn::details::FuncType::PROBE,
+                                        int>::type = 0>
+  void do_evaluate_slice(const B& b, G g) const;
+
+  // Rebuilds this view with a probe after each stage, for profile(). Sets
+  // *index to the index of the last probe in report, or -1 for roots.
+  template <typename T = int,
+            typename std::enable_if<
+                sizeof(T) && std::is_same<void*, P>::value, int>::type = 0>
+  View probe(Profile* report, long* index) const;
+
+  template <typename V = View,
+            typename std::enable_if<
+                sizeof(V) && !std::is_same<void*, P>::value, int>::type = 0>
+  typename fn::details::Probed<V>::type probe(Profile* report,
+                                              long* index) const;
+
+  template <typename V>
+  static typename fn::details::Probed<V>::type probe_parent(const V& v,
+                                                            Profile* report,
+                                                            long* index);
+
+  // The right side of a zip is the one pushing elements to it.
+  template <typename V1, typename V2>
+  static typename fn::details::Probed<std::pair<V1, V2>>::type probe_parent(
+      const std::pair<V1, V2>& p, Profile* report, long* index);
+
+  // Appends the plan of this view to plan, indented by depth, for explain().
+  // Returns the estimated number of elements of this view.
+  template <typename T = int,
+            typename std::enable_if<
+                sizeof(T) && std::is_same<void*, P>::value, int>::type = 0>
+  fn::details::Estimate explain(std::string* plan, size_t depth) const;
+
+  template <typename T = int, typename std::enable_if<
+                                  sizeof(T) && !std::is_same<void*, P>::value &&
+                                      t != fn::details::FuncType::ZIP,
+                                  int>::type = 0>
+  fn::details::Estimate explain(std::string* plan, size_t depth) const;
+
+  template <typename T = int, typename std::enable_if<
+                                  sizeof(T) && !std::is_same<void*, P>::value &&
+                                      t == fn::details::FuncType::ZIP,
+                                  int>::type = 0>
+  fn::details::Estimate explain(std::string* plan, size_t depth) const;
+
+  // Calls g for all elements of the inner collection of a flat_map.
+  template <typename I, typename G>
+  static void for_each_inner(const I& inner, G& g);
+
+  template <typename It, typename G>
+  static void for_each_inner(const std::pair<It, It>& inner, G& g);
+
+  template <typename G>
+  static void for_each_inner(const Tokens& inner, G& g);
+
+  template <template <typename...> class C2, typename E2,  // clang-format.
+            template <typename...> class R2, typename P2, typename F2,
+            fn::details::FuncType t2, typename G>
+  static void for_each_inner(const View<C2, E2, R2, P2, F2, t2>& inner, G& g);
+
   // The view is either materialized or not. If materalized container_ would
   // point to the container holding the actual data.
   CPtr container_;
@@ -347,6 +773,38 @@ View<std::vector, E> _(const std::initializer_list<E>& l);
 template <typename K, typename V>
 View<std::vector, std::pair<K, V>> _(const std::unordered_map<K, V>& l);
 
+// Creates a view of a copy of the given collection allocated in the arena. The
+// copy is destroyed when the arena is reset.
+template <template <typename...> class C, typename E>
+View<Span, E> _(const C<E>& c, Arena* arena);
+
+// Creates a sorted view of the given collection (see fn::sorted()).
+template <template <typename...> class C, typename E>
+View<C, E, fn::details::SortedCopy> _(fn::details::Sorted<C<E>> s);
+
+template <template <typename...> class C, typename E>
+View<C, E, fn::details::SortedRef> _(fn::details::Sorted<const C<E>*> s);
+
+// Declares that the given collection is sorted by operator<, for creating a
+// sorted view using fn::_:
+//
+//   auto window = _(fn::sorted(&timestamps)).filter(fn::between(from, to));
+//
+// Range filters on sorted views are evaluated using a binary search, and
+// sorted roots have constant time min(), max(), first() and last().
+template <template <typename...> class C, typename E>
+fn::details::Sorted<C<E>> sorted(C<E>&& c);
+
+template <template <typename...> class C, typename E>
+fn::details::Sorted<C<E>> sorted(const C<E>& c);
+
+template <template <typename...> class C, typename E>
+fn::details::Sorted<const C<E>*> sorted(const C<E>* c);
+
+// Returns a predicate that holds for values in [lo, hi].
+template <typename T>
+fn::details::Between<T> between(const T& lo, const T& hi);
+
 #define FN_CXX1Y (__cplusplus && __cplusplus > 201103L)
 
 #if FN_CXX1Y
@@ -0,0 +1,129 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_LINES_INL_H_
+#define FUNC_LINES_INL_H_
+
+#include <cstring>
+
+namespace fn {
+
+template <typename E>
+Lines<E>::Iterator::Iterator(const char* pos, const char* end)
+    : pos_(pos), end_(end) {
+  find_line();
+}
+
+template <typename E>
+typename Lines<E>::Iterator& Lines<E>::Iterator::operator++() {
+  // Skips the line and its '\n', if any.
+  pos_ = line_.data() + line_.size();
+  pos_ += pos_ != end_;
+  find_line();
+  return *this;
+}
+
+template <typename E>
+typename Lines<E>::Iterator Lines<E>::Iterator::operator++(int) {
+  auto cp = *this;
+  ++*this;
+  return cp;
+}
+
+template <typename E>
+void Lines<E>::Iterator::find_line() {
+  if (pos_ == end_) {
+    line_ = E(end_, 0);
+    return;
+  }
+
+  auto nl = static_cast<const char*>(memchr(pos_, '\n', end_ - pos_));
+  line_ = E(pos_, (nl == nullptr ? end_ : nl) - pos_);
+}
+
+template <typename E>
+Lines<E>::Lines(std::shared_ptr<const MappedFile> file, const char* begin,
+                const char* end)
+    : file_(std::move(file)),
+      begin_(begin),
+      end_(end),
+      size_(static_cast<size_t>(-1)) {}
+
+template <typename E>
+Lines<E>::Lines(const Lines& that)
+    : file_(that.file_),
+      begin_(that.begin_),
+      end_(that.end_),
+      size_(that.size_.load(std::memory_order_relaxed)) {}
+
+template <typename E>
+Lines<E>& Lines<E>::operator=(const Lines& that) {
+  file_ = that.file_;
+  begin_ = that.begin_;
+  end_ = that.end_;
+  size_.store(that.size_.load(std::memory_order_relaxed),
+              std::memory_order_relaxed);
+  return *this;
+}
+
+template <typename E>
+size_t Lines<E>::size() const {
+  const size_t size = size_.load(std::memory_order_relaxed);
+  if (size != static_cast<size_t>(-1)) {
+    return size;
+  }
+
+  // A last line without '\n' counts too.
+  size_t lines = 0;
+  for (auto p = begin_; p != end_; lines++) {
+    auto nl = static_cast<const char*>(memchr(p, '\n', end_ - p));
+    p = nl == nullptr ? end_ : nl + 1;
+  }
+
+  size_.store(lines, std::memory_order_relaxed);
+  return lines;
+}
+
+template <typename E>
+std::vector<Lines<E>> Lines<E>::split(size_t n) const {
+  std::vector<Lines> parts;
+  const size_t bytes = end_ - begin_;
+  auto begin = begin_;
+  for (size_t i = 1; i <= n && begin != end_; i++) {
+    // Each part ends after the first '\n' at or after its share of bytes.
+    auto end = begin_ + bytes * i / n;
+    if (end < begin) {
+      end = begin;
+    }
+
+    if (end != end_) {
+      auto nl = static_cast<const char*>(memchr(end, '\n', end_ - end));
+      end = nl == nullptr ? end_ : nl + 1;
+    }
+
+    parts.push_back(Lines(file_, begin, end));
+    begin = end;
+  }
+
+  return parts;
+}
+
+inline Lines<> mmap_lines(const std::string& path) {
+  auto file = std::make_shared<const MappedFile>(path);
+  return Lines<>(file, file->data(), file->data() + file->size());
+}
+
+}  // namespace fn
+
+#endif  // FUNC_LINES_INL_H_
@@ -0,0 +1,109 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_LINES_H_
+#define FUNC_LINES_H_
+
+#include <cstddef>
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fn/mapped_file.h"
+#include "fn/string_view.h"
+
+namespace fn {
+
+// The lines of a part of a mapped file, as views of type E (e.g., StringView)
+// on the mapping, without their '\n'. Copies share the mapping, which is
+// unmapped along with the last one.
+//
+// Lines are found while iterating, using memchr. Nothing is allocated per
+// line.
+template <typename E = StringView>
+class Lines {
+ public:
+  class Iterator : public std::iterator<std::forward_iterator_tag, E> {
+   public:
+    Iterator(const char* pos, const char* end);
+
+    const E& operator*() const { return line_; }
+    const E* operator->() const { return &line_; }
+
+    Iterator& operator++();
+    Iterator operator++(int);
+
+    bool operator==(const Iterator& that) const { return pos_ == that.pos_; }
+    bool operator!=(const Iterator& that) const { return pos_ != that.pos_; }
+
+   private:
+    void find_line();
+
+    const char* pos_;
+    const char* end_;
+    E line_;
+  };
+
+  // For compability with stl.
+  using value_type = E;
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+
+  Lines(std::shared_ptr<const MappedFile> file, const char* begin,
+        const char* end);
+
+  Lines(const Lines& that);
+  Lines& operator=(const Lines& that);
+
+  Iterator begin() const { return Iterator(begin_, end_); }
+  Iterator end() const { return Iterator(end_, end_); }
+
+  // Counts the lines, which scans them the first time. Threads calling it at
+  // once may each scan them.
+  size_t size() const;
+  bool empty() const { return begin_ == end_; }
+
+  // Splits the lines into at most n parts of about the same number of bytes,
+  // at line boundaries. The parts can be processed in parallel, each with its
+  // own view.
+  std::vector<Lines> split(size_t n) const;
+
+ private:
+  std::shared_ptr<const MappedFile> file_;
+  const char* begin_;
+  const char* end_;
+
+  // The number of lines once counted, or -1.
+  mutable std::atomic<size_t> size_;
+};
+
+// Maps the file at path in memory, for creating a view on its lines:
+//
+//   auto is_error = [](fn::StringView line) {
+//     return line.substr(0, 5) == "ERROR";
+//   };
+//   auto errors = _(fn::mmap_lines("/var/log/app.log")).filter(is_error);
+//
+// The kernel is advised that the file is read sequentially. Throws
+// std::system_error if the file cannot be mapped.
+Lines<> mmap_lines(const std::string& path);
+
+}  // namespace fn
+
+#include "fn/lines-inl.h"
+
+#endif  // FUNC_LINES_H_
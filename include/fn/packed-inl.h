@@ -0,0 +1,392 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_PACKED_INL_H_
+#define FUNC_PACKED_INL_H_
+
+#include <cerrno>
+#include <cstring>
+
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+#include <fcntl.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace fn {
+namespace details {
+
+// The first bytes of packed columns, followed by the version and the size of
+// the values.
+const char kPackedMagic[] = "FNPACK";
+const size_t kPackedMagicSize = 6;
+const size_t kPackedHeaderSize = 8;
+const uint8_t kPackedVersion = 1;
+
+// The bits of blocks storing their values as is.
+const uint8_t kRawBits = 64;
+
+// The number of bits needed to store v.
+inline int bit_width(uint64_t v) {
+#if defined(__GNUC__)
+  return v == 0 ? 0 : 64 - __builtin_clzll(v);
+#else
+  int n = 0;
+  for (; v != 0; v >>= 1) {
+    n++;
+  }
+
+  return n;
+#endif
+}
+
+// Values are packed in 4 interleaved lanes: value i is in lane i % 4, and the
+// 32-bit word w of a lane is at 4 * w + lane. The 4 lanes are decoded at once
+// using the same shifts.
+inline void pack_block(const uint32_t* values, int bits, uint32_t* words) {
+  memset(words, 0, 4 * bits * sizeof(uint32_t));
+  for (size_t i = 0; i < kPackedBlockSize; i++) {
+    const size_t bit = (i / 4) * bits;
+    const size_t word = 4 * (bit / 32) + i % 4;
+    const size_t shift = bit % 32;
+    words[word] |= values[i] << shift;
+    if (shift + bits > 32) {
+      words[word + 4] |= values[i] >> (32 - shift);
+    }
+  }
+}
+
+inline void unpack_block(const char* data, int bits, uint32_t* values) {
+  if (bits == 0) {
+    memset(values, 0, kPackedBlockSize * sizeof(uint32_t));
+    return;
+  }
+
+  const uint32_t mask = bits == 32 ? ~0u : (1u << bits) - 1;
+#if defined(__SSE2__)
+  const auto words = reinterpret_cast<const __m128i*>(data);
+  const auto m = _mm_set1_epi32(static_cast<int>(mask));
+  for (size_t k = 0; k < kPackedBlockSize / 4; k++) {
+    const size_t bit = k * bits;
+    const int shift = bit % 32;
+    auto v = _mm_srl_epi32(_mm_loadu_si128(words + bit / 32),
+                           _mm_cvtsi32_si128(shift));
+    if (shift + bits > 32) {
+      v = _mm_or_si128(v, _mm_sll_epi32(_mm_loadu_si128(words + bit / 32 + 1),
+                                        _mm_cvtsi32_si128(32 - shift)));
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values + 4 * k),
+                     _mm_and_si128(v, m));
+  }
+#else
+  uint32_t words[4 * 32];
+  memcpy(words, data, 4 * bits * sizeof(uint32_t));
+  for (size_t i = 0; i < kPackedBlockSize; i++) {
+    const size_t bit = (i / 4) * bits;
+    const size_t word = 4 * (bit / 32) + i % 4;
+    const size_t shift = bit % 32;
+    uint32_t v = words[word] >> shift;
+    if (shift + bits > 32) {
+      v |= words[word + 4] << (32 - shift);
+    }
+
+    values[i] = v & mask;
+  }
+#endif  // __SSE2__
+}
+
+template <typename T>
+size_t packed_block_bytes(const PackedBlockHeader& header) {
+  if (header.bits == kRawBits) {
+    return (header.count * sizeof(T) + 7) / 8 * 8;
+  }
+
+  return 4 * header.bits * sizeof(uint32_t);
+}
+
+template <typename T, typename O>
+PackedEncoder<T, O>::PackedEncoder(O* out) : out_(out), size_(0) {
+  char header[kPackedHeaderSize] = {};
+  memcpy(header, kPackedMagic, kPackedMagicSize);
+  header[kPackedMagicSize] = kPackedVersion;
+  header[kPackedMagicSize + 1] = sizeof(T);
+  out_->append(header, sizeof(header));
+}
+
+template <typename T, typename O>
+PackedEncoder<T, O>::~PackedEncoder() {
+  try {
+    flush();
+  } catch (...) {
+  }
+}
+
+template <typename T, typename O>
+void PackedEncoder<T, O>::flush() {
+  if (size_ == 0) {
+    return;
+  }
+
+  // Values are widened to 64 bits, where differences are computed modulo 2^64.
+  // The last block is padded with its last value, which changes neither its
+  // minimum, its maximum nor its order.
+  const size_t count = size_;
+  for (; size_ < kPackedBlockSize; size_++) {
+    block_[size_] = block_[count - 1];
+  }
+
+  size_ = 0;
+  T min = block_[0];
+  T max = block_[0];
+  uint64_t max_delta = 0;
+  bool sorted = true;
+  for (size_t i = 1; i < kPackedBlockSize; i++) {
+    min = std::min(min, block_[i]);
+    max = std::max(max, block_[i]);
+    sorted &= !(block_[i] < block_[i - 1]);
+    max_delta = std::max(max_delta, static_cast<uint64_t>(block_[i]) -
+                                        static_cast<uint64_t>(block_[i - 1]));
+  }
+
+  PackedBlockHeader header = {};
+  header.min = static_cast<uint64_t>(min);
+  header.max = static_cast<uint64_t>(max);
+  header.count = static_cast<uint16_t>(count);
+  int bits = bit_width(header.max - header.min);
+  if (sorted && bit_width(max_delta) < bits) {
+    bits = bit_width(max_delta);
+    header.delta = 1;
+  }
+
+  if (bits > 32) {
+    header.bits = kRawBits;
+    out_->append(reinterpret_cast<const char*>(&header), sizeof(header));
+    char raw[kPackedBlockSize * sizeof(T) + 8] = {};
+    memcpy(raw, block_, count * sizeof(T));
+    out_->append(raw, packed_block_bytes<T>(header));
+    return;
+  }
+
+  header.bits = static_cast<uint8_t>(bits);
+  uint32_t values[kPackedBlockSize];
+  for (size_t i = 0; i < kPackedBlockSize; i++) {
+    const auto base = header.delta && i > 0 ? block_[i - 1] : min;
+    values[i] = static_cast<uint32_t>(static_cast<uint64_t>(block_[i]) -
+                                      static_cast<uint64_t>(base));
+  }
+
+  uint32_t words[4 * 32];
+  pack_block(values, bits, words);
+  out_->append(reinterpret_cast<const char*>(&header), sizeof(header));
+  out_->append(reinterpret_cast<const char*>(words),
+               packed_block_bytes<T>(header));
+}
+
+template <typename T>
+void decode_packed_block(const PackedBlockHeader& header, const char* data,
+                         T* out) {
+  if (header.bits == kRawBits) {
+    memcpy(out, data, header.count * sizeof(T));
+    return;
+  }
+
+  uint32_t values[kPackedBlockSize];
+  unpack_block(data, header.bits, values);
+  uint64_t base = header.min;
+  if (header.delta) {
+    for (size_t i = 0; i < header.count; i++) {
+      base += values[i];
+      out[i] = static_cast<T>(base);
+    }
+
+    return;
+  }
+
+  for (size_t i = 0; i < header.count; i++) {
+    out[i] = static_cast<T>(base + values[i]);
+  }
+}
+
+inline PackedBlockHeader read_block_header(const char* block) {
+  PackedBlockHeader header;
+  memcpy(&header, block, sizeof(header));
+  return header;
+}
+
+}  // namespace details
+
+template <typename T>
+Packed<T>::Iterator::Iterator(const char* block, const char* end)
+    : block_(block), end_(end), index_(0), count_(0) {
+  if (block_ != end_) {
+    decode();
+  }
+}
+
+template <typename T>
+void Packed<T>::Iterator::next_block() {
+  const auto header = details::read_block_header(block_);
+  block_ += sizeof(header) + details::packed_block_bytes<T>(header);
+  index_ = 0;
+  if (block_ != end_) {
+    decode();
+  }
+}
+
+template <typename T>
+void Packed<T>::Iterator::decode() {
+  const auto header = details::read_block_header(block_);
+  count_ = header.count;
+  details::decode_packed_block(header, block_ + sizeof(header), values_);
+}
+
+template <typename T>
+Packed<T>::Packed(std::shared_ptr<const void> owner, const char* data,
+                  size_t size)
+    : owner_(std::move(owner)),
+      data_(data),
+      blocks_(data + details::kPackedHeaderSize),
+      bytes_(size),
+      size_(0) {
+  if (size < details::kPackedHeaderSize ||
+      memcmp(data, details::kPackedMagic, details::kPackedMagicSize) != 0 ||
+      data[details::kPackedMagicSize] != details::kPackedVersion ||
+      data[details::kPackedMagicSize + 1] != sizeof(T)) {
+    throw std::invalid_argument("Not a packed column of this type");
+  }
+
+  // Blocks are checked once, so that iterating never reads past the end.
+  const char* end = data + size;
+  for (const char* block = blocks_; block != end;) {
+    if (static_cast<size_t>(end - block) < sizeof(details::PackedBlockHeader)) {
+      throw std::invalid_argument("Truncated packed column");
+    }
+
+    const auto header = details::read_block_header(block);
+    if (header.count == 0 || header.count > kPackedBlockSize ||
+        (header.bits > 32 && header.bits != details::kRawBits)) {
+      throw std::invalid_argument("Corrupt packed column");
+    }
+
+    const size_t bytes =
+        sizeof(header) + details::packed_block_bytes<T>(header);
+    if (static_cast<size_t>(end - block) < bytes) {
+      throw std::invalid_argument("Truncated packed column");
+    }
+
+    block += bytes;
+    size_ += header.count;
+  }
+}
+
+template <typename T>
+template <typename G>
+void Packed<T>::for_each(G& g) const {
+  T values[kPackedBlockSize];
+  const char* end = data_ + bytes_;
+  for (const char* block = blocks_; block != end;) {
+    const auto header = details::read_block_header(block);
+    const auto data = block + sizeof(header);
+    block = data + details::packed_block_bytes<T>(header);
+    details::decode_packed_block(header, data, values);
+    for (size_t i = 0; i < header.count; i++) {
+      g(values[i]);
+    }
+  }
+}
+
+template <typename T>
+template <typename G>
+void Packed<T>::for_each_between(const T& lo, const T& hi, G& g) const {
+  T values[kPackedBlockSize];
+  const char* end = data_ + bytes_;
+  for (const char* block = blocks_; block != end;) {
+    const auto header = details::read_block_header(block);
+    const auto data = block + sizeof(header);
+    block = data + details::packed_block_bytes<T>(header);
+    const auto min = static_cast<T>(header.min);
+    const auto max = static_cast<T>(header.max);
+    if (max < lo || hi < min) {
+      continue;
+    }
+
+    details::decode_packed_block(header, data, values);
+    if (!(min < lo) && !(hi < max)) {
+      for (size_t i = 0; i < header.count; i++) {
+        g(values[i]);
+      }
+
+      continue;
+    }
+
+    for (size_t i = 0; i < header.count; i++) {
+      if (!(values[i] < lo) && !(hi < values[i])) {
+        g(values[i]);
+      }
+    }
+  }
+}
+
+template <typename T>
+PackedSink<T>::PackedSink(std::shared_ptr<details::BufferedWriter> writer)
+    : writer_(std::move(writer)),
+      encoder_(std::make_shared<Encoder>(writer_.get())) {}
+
+template <typename T>
+void PackedSink<T>::close() const {
+  encoder_->flush();
+  writer_->close();
+}
+
+template <typename T>
+Packed<T> packed(const std::vector<T>& values) {
+  auto out = std::make_shared<std::string>();
+  details::PackedEncoder<T, std::string> encoder(out.get());
+  for (const auto& e : values) {
+    encoder(e);
+  }
+
+  encoder.flush();
+  return Packed<T>(out, out->data(), out->size());
+}
+
+template <typename T>
+Packed<T> mmap_packed(const std::string& path) {
+  auto file = std::make_shared<const MappedFile>(path);
+  return Packed<T>(file, file->data(), file->size());
+}
+
+template <typename T>
+PackedSink<T> packed_sink(int fd) {
+  return PackedSink<T>(std::make_shared<details::BufferedWriter>(fd, false));
+}
+
+template <typename T>
+PackedSink<T> packed_sink(const std::string& path) {
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+
+  return PackedSink<T>(std::make_shared<details::BufferedWriter>(fd, true));
+}
+
+}  // namespace fn
+
+#endif  // FUNC_PACKED_INL_H_
@@ -0,0 +1,269 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_PACKED_H_
+#define FUNC_PACKED_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fn/details.h"
+#include "fn/mapped_file.h"
+#include "fn/sink.h"
+
+namespace fn {
+
+// The number of values in each block of a packed column.
+const size_t kPackedBlockSize = 128;
+
+namespace details {
+
+// The header of each block of a packed column, followed by its values. The
+// values are stored minus the minimum of the block (frame of reference), or as
+// the differences to the previous value in non-decreasing blocks where these
+// take fewer bits (delta), packed with the given number of bits each. Blocks
+// needing more than 32 bits store the values as is, with bits set to 64.
+struct PackedBlockHeader {
+  uint64_t min;
+  uint64_t max;
+  uint16_t count;
+  uint8_t bits;
+  uint8_t delta;
+  uint32_t reserved;
+};
+
+// Returns the number of bytes of the values of a block following its header.
+template <typename T>
+size_t packed_block_bytes(const PackedBlockHeader& header);
+
+// Encodes blocks of values to out, which has an append(const char*, size_t)
+// method.
+template <typename T, typename O>
+class PackedEncoder {
+ public:
+  explicit PackedEncoder(O* out);
+
+  // Encodes the last block, ignoring errors.
+  ~PackedEncoder();
+
+  PackedEncoder(const PackedEncoder&) = delete;
+  PackedEncoder& operator=(const PackedEncoder&) = delete;
+
+  void operator()(T e) {
+    block_[size_++] = e;
+    if (size_ == kPackedBlockSize) {
+      flush();
+    }
+  }
+
+  // Encodes the last block, which may be partial.
+  void flush();
+
+ private:
+  O* out_;
+  T block_[kPackedBlockSize];
+  size_t size_;
+};
+
+// Decodes the block at data, described by header, to out.
+template <typename T>
+void decode_packed_block(const PackedBlockHeader& header, const char* data,
+                         T* out);
+
+}  // namespace details
+
+// A column of integers compressed in blocks of kPackedBlockSize values, either
+// in memory or in a mapped file. Blocks are decoded one at a time as views are
+// evaluated, and range filters using fn::between() skip the blocks whose
+// minimum and maximum are outside of the range without decoding them:
+//
+//   auto ts = fn::mmap_packed<int64_t>("/data/timestamps.fnp");
+//   auto last_hour = _(ts).filter(fn::between(now - 3600, now)).size();
+//
+// Sorted columns, such as identifiers or timestamps, are compressed the most.
+// Copies share the encoded data.
+template <typename T>
+class Packed {
+  static_assert(std::is_integral<T>::value && sizeof(T) <= 8,
+                "Packed columns must be of integers");
+
+ public:
+  using value_type = T;
+  using size_type = size_t;
+
+  // Iterates over the values, decoding a block at a time.
+  class Iterator : public std::iterator<std::forward_iterator_tag, T> {
+   public:
+    Iterator(const char* block, const char* end);
+
+    const T& operator*() const { return values_[index_]; }
+
+    Iterator& operator++() {
+      if (++index_ == count_) {
+        next_block();
+      }
+
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      auto cp = *this;
+      ++*this;
+      return cp;
+    }
+
+    bool operator==(const Iterator& that) const {
+      return block_ == that.block_ && index_ == that.index_;
+    }
+
+    bool operator!=(const Iterator& that) const { return !(*this == that); }
+
+   private:
+    void next_block();
+    void decode();
+
+    const char* block_;
+    const char* end_;
+    size_t index_;
+    size_t count_;
+    T values_[kPackedBlockSize];
+  };
+
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+
+  // The encoded column in [data, data + size), which owner keeps alive. Throws
+  // std::invalid_argument if it is not a packed column of T.
+  Packed(std::shared_ptr<const void> owner, const char* data, size_t size);
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Returns the size of the encoded column, in bytes.
+  size_t bytes() const { return bytes_; }
+
+  Iterator begin() const { return Iterator(blocks_, data_ + bytes_); }
+  Iterator end() const { return Iterator(data_ + bytes_, data_ + bytes_); }
+
+  // Calls g for each value.
+  template <typename G>
+  void for_each(G& g) const;
+
+  // Calls g for each value in [lo, hi], skipping the blocks outside of it.
+  template <typename G>
+  void for_each_between(const T& lo, const T& hi, G& g) const;
+
+ private:
+  std::shared_ptr<const void> owner_;
+  const char* data_;
+  const char* blocks_;
+  size_t bytes_;
+  size_t size_;
+};
+
+// A function encoding the integers it is called with as a packed column, to a
+// file descriptor:
+//
+//   auto sink = fn::packed_sink<int64_t>("/data/timestamps.fnp");
+//   _(events).map([](const Event& e) { return e.time; }) >> sink;
+//   sink.close();
+//
+// Copies share the current block, which is written when closed, or when the
+// last copy is destroyed if not closed (ignoring errors).
+template <typename T>
+class PackedSink {
+ public:
+  explicit PackedSink(std::shared_ptr<details::BufferedWriter> writer);
+
+  void operator()(T e) const { (*encoder_)(e); }
+
+  // Writes the last block, and waits for all writes. Throws std::system_error
+  // if a write failed.
+  void close() const;
+
+ private:
+  using Encoder = details::PackedEncoder<T, details::BufferedWriter>;
+
+  std::shared_ptr<details::BufferedWriter> writer_;
+  std::shared_ptr<Encoder> encoder_;
+};
+
+// Returns the values, encoded as a packed column in memory.
+template <typename T>
+Packed<T> packed(const std::vector<T>& values);
+
+// Maps the packed column of T at path in memory. Throws std::system_error if
+// the file cannot be mapped, and std::invalid_argument if it is not a packed
+// column of T.
+template <typename T>
+Packed<T> mmap_packed(const std::string& path);
+
+// Returns a sink encoding a packed column to fd, which it does not close.
+template <typename T>
+PackedSink<T> packed_sink(int fd);
+
+// Returns a sink encoding a packed column to the file at path, created or
+// truncated. Throws std::system_error if the file cannot be opened.
+template <typename T>
+PackedSink<T> packed_sink(const std::string& path);
+
+namespace details {
+
+template <typename C>
+struct is_packed {
+  static const bool value = false;
+};
+
+template <typename T>
+struct is_packed<Packed<T>> {
+  static const bool value = true;
+};
+
+// Whether a filter stage with function F on parent P skips blocks: F is a range
+// filter and P is a root view on a packed column, not sorted (sorted views are
+// sliced using a binary search instead).
+template <typename P, typename F, typename = void>
+struct is_block_range_stage {
+  static const bool value = false;
+};
+
+template <typename P, typename F>
+struct is_block_range_stage<
+    P, F, typename std::enable_if<
+              is_range_filter<F>::value &&
+              std::is_same<void*, typename P::PView>::value &&
+              !P::sliceable &&
+              is_packed<typename P::Container>::value>::type> {
+  static const bool value = true;
+};
+
+template <typename T, typename G>
+void for_each_element(const Packed<T>& c, G& g) {
+  c.for_each(g);
+}
+
+}  // namespace details
+
+}  // namespace fn
+
+#include "fn/packed-inl.h"
+
+#endif  // FUNC_PACKED_H_
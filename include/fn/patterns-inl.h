@@ -0,0 +1,180 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_PATTERNS_INL_H_
+#define FUNC_PATTERNS_INL_H_
+
+#include <algorithm>
+#include <deque>
+
+namespace fn {
+namespace details {
+
+inline AhoCorasick::AhoCorasick(const std::vector<std::string>& patterns)
+    : num_classes_(1), pairs_(1024, 0), first_(StringView()) {
+  std::string first;
+  for (auto& c : classes_) {
+    c = 0;
+  }
+
+  for (const auto& p : patterns) {
+    for (const char c : p) {
+      auto& k = classes_[static_cast<unsigned char>(c)];
+      if (k == 0) {
+        k = num_classes_++;
+      }
+    }
+
+    if (p.empty()) {
+      continue;
+    }
+
+    // Patterns of one byte may be followed by any byte.
+    first.push_back(p[0]);
+    const size_t a = static_cast<unsigned char>(p[0]);
+    for (size_t b = 0; b < 256; b++) {
+      if (p.size() == 1 || b == static_cast<unsigned char>(p[1])) {
+        pairs_[(a << 8 | b) >> 6] |= uint64_t(1) << (b & 63);
+      }
+    }
+  }
+
+  first_ = ByteSet(first);
+
+  // Builds the trie of the patterns, state 0 being its root.
+  next_.assign(num_classes_, 0);
+  matches_.assign(1, false);
+  for (const auto& p : patterns) {
+    uint32_t state = 0;
+    for (const char c : p) {
+      state = add(state, classes_[static_cast<unsigned char>(c)]);
+    }
+
+    matches_[state] = true;
+  }
+
+  // Turns the trie into an automaton, breadth first: missing transitions of a
+  // state go where those of its longest proper suffix in the trie go.
+  std::vector<uint32_t> fail(matches_.size(), 0);
+  std::deque<uint32_t> queue;
+  for (size_t c = 0; c < num_classes_; c++) {
+    if (next_[c] != 0) {
+      queue.push_back(next_[c]);
+    }
+  }
+
+  while (!queue.empty()) {
+    const uint32_t state = queue.front();
+    queue.pop_front();
+    matches_[state] = matches_[state] || matches_[fail[state]];
+    for (size_t c = 0; c < num_classes_; c++) {
+      auto& next = next_[state * num_classes_ + c];
+      const uint32_t fallback = next_[fail[state] * num_classes_ + c];
+      if (next == 0) {
+        next = fallback;
+      } else {
+        fail[next] = fallback;
+        queue.push_back(next);
+      }
+    }
+  }
+
+  // Transitions go to the offset of the row of their state, with the lowest
+  // bit set for states where a pattern ends. Rows have an even size.
+  stride_ = num_classes_ + (num_classes_ & 1);
+  std::vector<uint32_t> table(matches_.size() * stride_, 0);
+  for (size_t state = 0; state < matches_.size(); state++) {
+    for (size_t c = 0; c < num_classes_; c++) {
+      const uint32_t next = next_[state * num_classes_ + c];
+      table[state * stride_ + c] = next * stride_ | matches_[next];
+    }
+  }
+
+  next_.swap(table);
+}
+
+inline uint32_t AhoCorasick::add(uint32_t state, uint16_t c) {
+  auto next = next_[state * num_classes_ + c];
+  if (next == 0) {
+    next = matches_.size();
+    next_[state * num_classes_ + c] = next;
+    next_.resize(next_.size() + num_classes_, 0);
+    matches_.push_back(false);
+  }
+
+  return next;
+}
+
+inline bool AhoCorasick::contains_any(StringView text) const {
+  if (matches_[0]) {
+    return true;
+  }
+
+  uint32_t state = 0;
+  for (size_t i = 0; i < text.size(); i++) {
+    if (state == 0) {
+      i = skip(text, i);
+      if (i == text.size()) {
+        break;
+      }
+    }
+
+    state = next_[state + classes_[static_cast<unsigned char>(text[i])]];
+    if (state & 1) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+inline size_t AhoCorasick::skip(StringView text, size_t i) const {
+  if (first_.size() > kSimdByteSetSize) {
+    for (; i < text.size(); i++) {
+      if (starts_pattern(text, i)) {
+        return i;
+      }
+    }
+
+    return text.size();
+  }
+
+  for (; i < text.size(); i += kByteSetBlockSize) {
+    const size_t n = std::min(text.size() - i, kByteSetBlockSize);
+    uint64_t m = first_.mask(text.data() + i, n);
+    for (; m != 0; m &= m - 1) {
+      const size_t pos = i + count_trailing_zeros(m);
+      if (pos >= text.size() || starts_pattern(text, pos)) {
+        return std::min(pos, text.size());
+      }
+    }
+  }
+
+  return text.size();
+}
+
+inline bool AhoCorasick::starts_pattern(StringView text, size_t i) const {
+  if (i + 1 == text.size()) {
+    return first_.contains(text[i]);
+  }
+
+  const size_t pair = static_cast<unsigned char>(text[i]) << 8 |
+                      static_cast<unsigned char>(text[i + 1]);
+  return pairs_[pair >> 6] >> (pair & 63) & 1;
+}
+
+}  // namespace details
+}  // namespace fn
+
+#endif  // FUNC_PATTERNS_INL_H_
@@ -0,0 +1,96 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_PATTERNS_H_
+#define FUNC_PATTERNS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fn/byte_set.h"
+#include "fn/string_view.h"
+
+namespace fn {
+namespace details {
+
+// An Aho-Corasick automaton finding whether a text contains any of a set of
+// patterns in one pass over it. Its transitions are a dense table, indexed by
+// state and by class of bytes, where bytes absent from the patterns all share a
+// class. In the initial state, the text is skipped up to the next pair of bytes
+// starting a pattern. When patterns start with few distinct bytes, they are
+// looked for 64 bytes at a time using SIMD instructions.
+//
+// The automaton is immutable once built, and can be shared between threads.
+class AhoCorasick {
+ public:
+  explicit AhoCorasick(const std::vector<std::string>& patterns);
+
+  bool contains_any(StringView text) const;
+
+ private:
+  uint32_t add(uint32_t state, uint16_t c);
+
+  // Returns the position of the first pair of bytes starting a pattern at or
+  // after i, or the size of the text.
+  size_t skip(StringView text, size_t i) const;
+  bool starts_pattern(StringView text, size_t i) const;
+
+  // The class of each byte, and the number of classes.
+  uint16_t classes_[256];
+  size_t num_classes_;
+
+  // The transitions of each state, and whether a pattern ends at a state.
+  std::vector<uint32_t> next_;
+  std::vector<uint8_t> matches_;
+  size_t stride_;
+
+  // The pairs of bytes starting the patterns, as a bitmap, and their first
+  // bytes.
+  std::vector<uint64_t> pairs_;
+  ByteSet first_;
+};
+
+}  // namespace details
+
+// A predicate matching strings that contain any of a set of patterns. The
+// patterns are compiled once, and copies of the predicate share them.
+class ContainsAny {
+ public:
+  explicit ContainsAny(const std::vector<std::string>& patterns)
+      : automaton_(std::make_shared<const details::AhoCorasick>(patterns)) {}
+
+  bool operator()(StringView s) const { return automaton_->contains_any(s); }
+
+ private:
+  std::shared_ptr<const details::AhoCorasick> automaton_;
+};
+
+// Returns a predicate matching strings that contain any of the patterns. Its
+// cost does not depend on the number of patterns:
+//
+//   auto alerts = _(fn::mmap_lines(path))
+//                     .filter(fn::contains_any({"OOM", "panic", "timeout"}));
+inline ContainsAny contains_any(const std::vector<std::string>& patterns) {
+  return ContainsAny(patterns);
+}
+
+}  // namespace fn
+
+#include "fn/patterns-inl.h"
+
+#endif  // FUNC_PATTERNS_H_
@@ -0,0 +1,147 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_PROFILE_INL_H_
+#define FUNC_PROFILE_INL_H_
+
+#include <cstdio>
+
+#include <algorithm>
+
+namespace fn {
+
+inline const std::vector<Profile::Stage>& Profile::stages() const {
+  stages_.resize(counters_.size());
+  for (size_t i = 0; i < counters_.size(); i++) {
+    const auto& c = counters_[i];
+    auto& s = stages_[i];
+    s.position = i + 1;
+    s.in = c.parent < 0 ? c.root : counters_[c.parent].out;
+    s.out = c.out;
+
+    s.nanos = before_nanos(i) - after_nanos(i);
+  }
+
+  return stages_;
+}
+
+inline double Profile::sink_nanos() const {
+  return counters_.empty() ? 0 : after_nanos(counters_.size() - 1);
+}
+
+inline double Profile::nanos() const {
+  // The last stage is evaluated first, and returns last.
+  return counters_.empty() ? 0 : counters_.back().nanos;
+}
+
+inline std::string Profile::text() const {
+  char line[128];
+  std::string text;
+  snprintf(line, sizeof(line), "%-4s%-12s%12s%12s%12s%12s\n", "#", "stage",
+           "in", "out", "selectivity", "time (ms)");
+  text += line;
+  for (const auto& s : stages()) {
+    snprintf(line, sizeof(line), "%-4zu%-12s%12zu%12zu%12.3f%12.3f\n",
+             s.position, s.type.c_str(), s.in, s.out, s.selectivity(),
+             s.nanos / 1e6);
+    text += line;
+  }
+
+  snprintf(line, sizeof(line), "%-4s%-12s%48.3f\n", "", "sink",
+           sink_nanos() / 1e6);
+  text += line;
+  snprintf(line, sizeof(line), "%-4s%-12s%48.3f\n", "", "total",
+           nanos() / 1e6);
+  text += line;
+  return text;
+}
+
+inline std::string Profile::json() const {
+  char field[256];
+  std::string json = "{\"stages\": [";
+  for (const auto& s : stages()) {
+    snprintf(field, sizeof(field),
+             "%s{\"position\": %zu, \"type\": \"%s\", \"in\": %zu, "
+             "\"out\": %zu, \"selectivity\": %g, \"nanos\": %.0f}",
+             s.position == 1 ? "" : ", ", s.position, s.type.c_str(), s.in,
+             s.out, s.selectivity(), s.nanos);
+    json += field;
+  }
+
+  snprintf(field, sizeof(field), "], \"sink_nanos\": %.0f, \"nanos\": %.0f}",
+           sink_nanos(), nanos());
+  json += field;
+  return json;
+}
+
+inline long Profile::add(details::FuncType t, long parent) {
+  counters_.push_back(Counters{parent, 0, 0, 0, 0, 0});
+  stages_.push_back(Stage{details::func_type_name(t), 0, 0, 0, 0});
+  return counters_.size() - 1;
+}
+
+inline double Profile::before_nanos(long index) const {
+  // The first stage gets the whole evaluation.
+  const auto& c = counters_[index];
+  return c.parent < 0 ? c.nanos : after_nanos(c.parent);
+}
+
+inline double Profile::after_nanos(long index) const {
+  // Extrapolated from the samples, within the time before the stage.
+  const auto& c = counters_[index];
+  const auto after = c.samples ? c.sampled_nanos * c.out / c.samples : 0;
+  return std::min(before_nanos(index), std::max(0.0, after));
+}
+
+namespace details {
+
+inline void Probe::record(size_t root, size_t out, double nanos,
+                          double sampled_nanos, size_t samples) const {
+  auto& c = profile->counters_[index];
+  c.root += root;
+  c.out += out;
+  c.nanos += nanos;
+  c.sampled_nanos += sampled_nanos;
+  c.samples += samples;
+}
+
+inline const char* func_type_name(FuncType t) {
+  switch (t) {
+    case FuncType::FILTER:
+      return "FILTER";
+    case FuncType::FLAT_MAP:
+      return "FLAT_MAP";
+    case FuncType::FOLD_LEFT:
+      return "FOLD_LEFT";
+    case FuncType::KEEP:
+      return "KEEP";
+    case FuncType::MAP:
+      return "MAP";
+    case FuncType::MAP_FILTER:
+      return "MAP_FILTER";
+    case FuncType::PROBE:
+      return "PROBE";
+    case FuncType::SKIP:
+      return "SKIP";
+    case FuncType::ZIP:
+      return "ZIP";
+  }
+
+  return "";
+}
+
+}  // namespace details
+}  // namespace fn
+
+#endif  // FUNC_PROFILE_INL_H_
@@ -0,0 +1,252 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_PROFILE_H_
+#define FUNC_PROFILE_H_
+
+#include <cstddef>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "fn/details.h"
+
+namespace fn {
+
+namespace details {
+struct Probe;
+}  // namespace details
+
+// Profile is a report of the elements and the time spent in each stage of a
+// view. It is filled by evaluating the view returned by View::profile():
+//
+//   fn::Profile profile;
+//   auto evens = view.profile(&profile).as_vector();
+//   std::cerr << profile.text();
+//
+// Stages are numbered from the root. The time of a stage includes the time
+// spent in its functions (e.g., the predicates of a filter), but not in the
+// stages after it. Times are estimated by timing a sample of the elements of
+// each evaluation. Iterators only count elements. Evaluating the view again
+// adds to the report.
+class Profile {
+ public:
+  struct Stage {
+    // The type of the stage, e.g., "FILTER".
+    std::string type;
+
+    // The position of the stage, starting from 1 next to the root.
+    size_t position;
+
+    // Number of elements received and produced by the stage. The first stage
+    // receives all the elements of its root.
+    size_t in;
+    size_t out;
+
+    // Estimated time spent in the stage, in nanoseconds.
+    double nanos;
+
+    // The ratio of elements produced to elements received.
+    double selectivity() const { return in ? double(out) / in : 1; }
+  };
+
+  Profile() : timing_(false) {}
+
+  Profile(const Profile&) = delete;
+  Profile& operator=(const Profile&) = delete;
+
+  const std::vector<Stage>& stages() const;
+
+  // Estimated time spent after the last stage (e.g., in for_each()), in
+  // nanoseconds.
+  double sink_nanos() const;
+
+  // Time spent evaluating the view, in nanoseconds.
+  double nanos() const;
+
+  // Formats the report as a table, or as a JSON object.
+  std::string text() const;
+  std::string json() const;
+
+ private:
+  // Raw counters of a stage, accumulated over evaluations.
+  struct Counters {
+    long parent;
+    size_t root;
+    size_t out;
+    double nanos;
+    double sampled_nanos;
+    size_t samples;
+  };
+
+  // Adds a stage following the given stage, or the root if parent is -1.
+  long add(details::FuncType t, long parent);
+
+  // Estimated time spent from the start of the given stage, and after it.
+  double before_nanos(long index) const;
+  double after_nanos(long index) const;
+
+  std::vector<Counters> counters_;
+  mutable std::vector<Stage> stages_;
+  bool timing_;
+
+  template <template <typename...> class CF, typename EF, template <typename...>
+            class RF, typename PF, typename FF, details::FuncType tf>
+  friend class View;
+
+  friend struct details::Probe;
+};
+
+namespace details {
+
+// One out of this many elements is timed by a probe.
+const size_t kProbeSample = 16;
+
+// The function of a probe stage, counting the elements produced by its parent
+// stage (see View::profile()).
+struct Probe {
+  Probe(Profile* profile, long index) : profile(profile), index(index) {}
+
+  // Whether an element is being timed by a probe of the profile.
+  bool& timing() const { return profile->timing_; }
+
+  // Counts one element produced while iterating.
+  void count() const { profile->counters_[index].out++; }
+
+  // Records an evaluation of the parent stage.
+  void record(size_t root, size_t out, double nanos, double sampled_nanos,
+              size_t samples) const;
+
+  Profile* profile;
+  long index;
+};
+
+// Passes the elements produced by the parent of a probe to g, timing about one
+// out of kProbeSample calls to g.
+template <typename G>
+class ProbeRun {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Nanos = std::chrono::duration<double, std::nano>;
+
+  ProbeRun(const Probe& probe, G* g)
+      : probe_(probe),
+        g_(g),
+        start_(Clock::now()),
+        out_(0),
+        next_sample_(1),
+        sampled_nanos_(0),
+        samples_(0) {}
+
+  // Elements are not timed while a following probe is timing one, so that
+  // probes do not time each other.
+  template <typename A>
+  void operator()(const A& a) {
+    bool& timing = probe_.timing();
+    if (++out_ < next_sample_ || timing) {
+      (*g_)(a);
+      return;
+    }
+
+    // The time it takes to read the clock is measured along with each sample,
+    // and subtracted from it.
+    timing = true;
+    const auto before = Clock::now();
+    const auto start = Clock::now();
+    (*g_)(a);
+    const auto end = Clock::now();
+    timing = false;
+
+    sampled_nanos_ += Nanos((end - start) - (start - before)).count();
+    samples_++;
+    next_sample_ = out_ + kProbeSample;
+  }
+
+  // Records the evaluation. root is the number of elements of the root, if the
+  // parent is the first stage.
+  void finish(size_t root) {
+    probe_.record(root, out_, Nanos(Clock::now() - start_).count(),
+                  sampled_nanos_, samples_);
+  }
+
+ private:
+  const Probe& probe_;
+  G* g_;
+  Clock::time_point start_;
+  size_t out_;
+  size_t next_sample_;
+  double sampled_nanos_;
+  size_t samples_;
+};
+
+// Whether V is a root view.
+template <typename V>
+struct is_root_view {
+  static const bool value = std::is_same<void*, typename V::PView>::value;
+};
+
+template <typename V1, typename V2>
+struct is_root_view<std::pair<V1, V2>> {
+  static const bool value = false;
+};
+
+// The number of elements received by v, if it is the first stage of a view.
+template <typename V,
+          typename std::enable_if<is_root_view<typename V::PView>::value,
+                                  int>::type = 0>
+size_t first_stage_input(const V& v) {
+  return v.root_size();
+}
+
+template <typename V,
+          typename std::enable_if<!is_root_view<typename V::PView>::value,
+                                  int>::type = 0>
+size_t first_stage_input(const V&) {
+  return 0;
+}
+
+// The type of a view rebuilt with a probe stage after each of its stages.
+template <typename V, bool root = is_root_view<V>::value>
+struct Probed {
+  using Stage = typename V::template Rebind<
+      typename V::Element, typename Probed<typename V::PView>::type,
+      typename V::Func, V::func_type>;
+  using type = typename Stage::template Rebind<typename Stage::Element, Stage,
+                                               Probe, FuncType::PROBE>;
+};
+
+template <typename V>
+struct Probed<V, true> {
+  using type = V;
+};
+
+template <typename V1, typename V2>
+struct Probed<std::pair<V1, V2>, false> {
+  using type =
+      std::pair<typename Probed<V1>::type, typename Probed<V2>::type>;
+};
+
+// The name of a stage type in profiles.
+const char* func_type_name(FuncType t);
+
+}  // namespace details
+}  // namespace fn
+
+#include "fn/profile-inl.h"
+
+#endif  // FUNC_PROFILE_H_
@@ -0,0 +1,64 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_RECORDS_INL_H_
+#define FUNC_RECORDS_INL_H_
+
+#include <cstdint>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace fn {
+
+template <typename T>
+Records<T> Records<T>::drop(size_t n) const {
+  n = std::min(n, size_);
+  return Records(file_, data_ + n, size_ - n);
+}
+
+template <typename T>
+Records<T> Records<T>::take(size_t n) const {
+  return Records(file_, data_, std::min(n, size_));
+}
+
+template <typename T>
+std::vector<Records<T>> Records<T>::split(size_t n) const {
+  std::vector<Records> parts;
+  n = std::min(n, size_);
+  for (size_t i = 0; i < n; i++) {
+    const size_t begin = size_ * i / n;
+    const size_t end = size_ * (i + 1) / n;
+    parts.push_back(Records(file_, data_ + begin, end - begin));
+  }
+
+  return parts;
+}
+
+template <typename T>
+Records<T> records(const std::string& path, size_t offset) {
+  auto file = std::make_shared<const MappedFile>(path);
+  offset = std::min(offset, file->size());
+  const char* data = file->data() + offset;
+  if (reinterpret_cast<uintptr_t>(data) % alignof(T) != 0) {
+    throw std::invalid_argument("misaligned records in " + path);
+  }
+
+  const size_t size = (file->size() - offset) / sizeof(T);
+  return Records<T>(file, reinterpret_cast<const T*>(data), size);
+}
+
+}  // namespace fn
+
+#endif  // FUNC_RECORDS_INL_H_
@@ -0,0 +1,94 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_RECORDS_H_
+#define FUNC_RECORDS_H_
+
+#include <cstddef>
+
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "fn/mapped_file.h"
+
+namespace fn {
+
+// The fixed-width records of type T stored back to back in a part of a mapped
+// file. Elements are read in place: like a Span, Records is contiguous, so
+// views on it are evaluated in batches or using bitmaps where possible. Copies
+// share the mapping, which is unmapped along with the last one.
+template <typename T>
+class Records {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Records must be trivially copyable");
+
+ public:
+  using value_type = T;
+  using size_type = size_t;
+  using iterator = const T*;
+  using const_iterator = const T*;
+
+  Records(std::shared_ptr<const MappedFile> file, const T* data, size_t size)
+      : file_(std::move(file)), data_(data), size_(size) {}
+
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const T& operator[](size_t i) const { return data_[i]; }
+
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+  // Returns the records after the first n, in constant time.
+  Records drop(size_t n) const;
+
+  // Returns the first n records, in constant time.
+  Records take(size_t n) const;
+
+  // Splits the records into at most n parts of about the same size. The parts
+  // can be processed in parallel, each with its own view.
+  std::vector<Records> split(size_t n) const;
+
+ private:
+  std::shared_ptr<const MappedFile> file_;
+  const T* data_;
+  size_t size_;
+};
+
+// Maps the file at path in memory, for creating a view on the records of type
+// T it stores from the given offset, skipping a header:
+//
+//   struct Sample {
+//     int64_t time;
+//     double value;
+//   };
+//
+//   auto samples = fn::records<Sample>("/data/metrics.bin", kHeaderSize);
+//   auto high = _(samples.take(samples.size() - kFooterRecords))
+//                   .filter([](const Sample& s) { return s.value > 0.9; });
+//
+// Bytes after the last whole record are ignored; use take() to skip a footer.
+// Throws std::system_error if the file cannot be mapped, and
+// std::invalid_argument if the records at offset are not aligned for T.
+template <typename T>
+Records<T> records(const std::string& path, size_t offset = 0);
+
+}  // namespace fn
+
+#include "fn/records-inl.h"
+
+#endif  // FUNC_RECORDS_H_
@@ -0,0 +1,345 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_SINK_INL_H_
+#define FUNC_SINK_INL_H_
+
+#include <cerrno>
+#include <cstdlib>
+
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace fn {
+namespace details {
+
+// The alignment of the buffers of sinks, as required by O_DIRECT.
+const size_t kSinkAlignment = 4096;
+
+inline BufferedWriter::BufferedWriter(int fd, bool owned)
+    : fd_(fd),
+      owned_(owned),
+      buffers_(),
+      submitted_(0),
+      written_(0),
+      closed_(false) {
+  // The destructor does not run if this throws, so the buffers allocated so
+  // far are freed here.
+  try {
+    for (auto& buffer : buffers_) {
+      void* p = nullptr;
+      if (posix_memalign(&p, kSinkAlignment, kSinkBufferSize) != 0) {
+        throw std::bad_alloc();
+      }
+
+      buffer = static_cast<char*>(p);
+    }
+
+    pos_ = buffers_[0];
+    end_ = pos_ + kSinkBufferSize;
+    thread_ = std::thread([this]() { run(); });
+  } catch (...) {
+    for (auto buffer : buffers_) {
+      free(buffer);
+    }
+
+    throw;
+  }
+}
+
+inline BufferedWriter::~BufferedWriter() {
+  try {
+    close();
+  } catch (...) {
+  }
+
+  for (auto buffer : buffers_) {
+    free(buffer);
+  }
+}
+
+inline void BufferedWriter::close() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (closed_) {
+      return;
+    }
+
+    cond_.wait(lock, [&] { return written_ == submitted_ || error_; });
+    closed_ = true;
+    cond_.notify_all();
+  }
+
+  thread_.join();
+  const auto error = error_;
+  const size_t size = pos_ - buffers_[submitted_ % kSinkBuffers];
+  const char* data = buffers_[submitted_ % kSinkBuffers];
+  // Every later append takes the slow path, which throws.
+  pos_ = end_;
+  // The last buffer is only partly full, so it is written in the calling
+  // thread, without O_DIRECT, which requires whole blocks.
+  int errno_ = 0;
+#ifdef O_DIRECT
+  const int flags = fcntl(fd_, F_GETFL);
+  if (!error && flags >= 0 && (flags & O_DIRECT) != 0) {
+    fcntl(fd_, F_SETFL, flags & ~O_DIRECT);
+  }
+#endif  // O_DIRECT
+
+  for (size_t done = 0; !error && done < size;) {
+    const ssize_t n = write(fd_, data + done, size - done);
+    if (n < 0 && errno != EINTR) {
+      errno_ = errno;
+      break;
+    }
+
+    done += std::max<ssize_t>(n, 0);
+  }
+
+  if (owned_ && ::close(fd_) != 0 && errno_ == 0) {
+    errno_ = errno;
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+
+  if (errno_ != 0) {
+    throw std::system_error(errno_, std::generic_category(), "write");
+  }
+}
+
+inline void BufferedWriter::append_slow(const void* data, size_t size) {
+  if (closed_) {
+    throw std::logic_error("BufferedWriter closed");
+  }
+
+  auto bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    const size_t n = std::min(size, static_cast<size_t>(end_ - pos_));
+    memcpy(pos_, bytes, n);
+    pos_ += n;
+    bytes += n;
+    size -= n;
+    if (pos_ == end_) {
+      submit();
+    }
+  }
+}
+
+inline void BufferedWriter::submit() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  submitted_++;
+  cond_.notify_all();
+  cond_.wait(lock, [&] { return submitted_ - written_ < kSinkBuffers; });
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+
+  pos_ = buffers_[submitted_ % kSinkBuffers];
+  end_ = pos_ + kSinkBufferSize;
+}
+
+inline void BufferedWriter::run() {
+  try {
+    std::vector<iovec> iov;
+    for (;;) {
+      size_t begin;
+      size_t end;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [&] { return submitted_ > written_ || closed_; });
+        if (submitted_ == written_) {
+          return;
+        }
+
+        begin = written_;
+        end = submitted_;
+      }
+
+      iov.clear();
+      for (size_t i = begin; i < end; i++) {
+        iov.push_back(iovec{buffers_[i % kSinkBuffers], kSinkBufferSize});
+      }
+
+      // Partial writes resume from the first buffer not fully written.
+      for (size_t i = 0; i < iov.size();) {
+        const ssize_t n = writev(fd_, &iov[i], iov.size() - i);
+        if (n < 0 && errno == EINTR) {
+          continue;
+        }
+
+        if (n < 0) {
+          throw std::system_error(errno, std::generic_category(), "write");
+        }
+
+        for (size_t left = n; left > 0;) {
+          const size_t m = std::min(left, iov[i].iov_len);
+          iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + m;
+          iov[i].iov_len -= m;
+          left -= m;
+          i += iov[i].iov_len == 0;
+        }
+      }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      written_ = end;
+      cond_.notify_all();
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = std::current_exception();
+
+    // Nothing more is written, and waiting producers are released.
+    written_ = submitted_;
+    cond_.notify_all();
+  }
+}
+
+// The longest text of an integer or floating point number.
+const size_t kMaxNumberSize = 32;
+
+// Writes the digits of v ending at end, and returns where they begin.
+template <typename U>
+char* format_digits(U v, char* end) {
+  static const char kPairs[] =
+      "0001020304050607080910111213141516171819202122232425262728293031323334"
+      "3536373839404142434445464748495051525354555657585960616263646566676869"
+      "707172737475767778798081828384858687888990919293949596979899";
+  while (v >= 100) {
+    const auto i = static_cast<size_t>(v % 100) * 2;
+    v /= 100;
+    *--end = kPairs[i + 1];
+    *--end = kPairs[i];
+  }
+
+  if (v >= 10) {
+    const auto i = static_cast<size_t>(v) * 2;
+    *--end = kPairs[i + 1];
+    *--end = kPairs[i];
+  } else {
+    *--end = static_cast<char>('0' + v);
+  }
+
+  return end;
+}
+
+// Writes v ending at end, and returns where it begins.
+template <typename T>
+char* format_integer(T v, char* end) {
+  using U = typename std::make_unsigned<T>::type;
+  if (v >= 0) {
+    return format_digits(static_cast<U>(v), end);
+  }
+
+  // Negating the unsigned value is defined for the lowest value too.
+  auto begin = format_digits(static_cast<U>(0 - static_cast<U>(v)), end);
+  *--begin = '-';
+  return begin;
+}
+
+// Writes the shortest text of v read back as v to out, and returns its end.
+template <typename T>
+char* format_floating_point(T v, char* out) {
+#if defined(__cpp_lib_to_chars)
+  return std::to_chars(out, out + kMaxNumberSize, v).ptr;
+#else
+  // Without std::to_chars, 15 digits are enough for most numbers.
+  int size = snprintf(out, kMaxNumberSize, "%.15g", static_cast<double>(v));
+  if (static_cast<T>(strtod(out, nullptr)) != v) {
+    size = snprintf(out, kMaxNumberSize, "%.17g", static_cast<double>(v));
+  }
+
+  return out + size;
+#endif  // __cpp_lib_to_chars
+}
+
+}  // namespace details
+
+template <typename T>
+void TextSink::operator()(const T& e) const {
+  write(e);
+  writer_->append(terminator_.data(), terminator_.size());
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value>::type TextSink::write(
+    T e) const {
+  char text[details::kMaxNumberSize];
+  char* end = text + sizeof(text);
+  char* begin = details::format_integer(e, end);
+  writer_->append(begin, end - begin);
+}
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+TextSink::write(T e) const {
+  char text[details::kMaxNumberSize];
+  writer_->append(text, details::format_floating_point(e, text) - text);
+}
+
+template <typename A, typename B>
+void TextSink::write(const std::pair<A, B>& e) const {
+  write(e.first);
+  writer_->append(separator_.data(), separator_.size());
+  write(e.second);
+}
+
+inline TextSink text_sink(int fd, std::string separator,
+                          std::string terminator) {
+  return TextSink(std::make_shared<details::BufferedWriter>(fd, false),
+                  std::move(separator), std::move(terminator));
+}
+
+inline TextSink text_sink(FILE* f, std::string separator,
+                          std::string terminator) {
+  fflush(f);
+  return text_sink(fileno(f), std::move(separator), std::move(terminator));
+}
+
+inline BinarySink binary_sink(int fd) {
+  return BinarySink(std::make_shared<details::BufferedWriter>(fd, false));
+}
+
+inline BinarySink binary_sink(const std::string& path, WriteMode mode) {
+  int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+  if (mode == WriteMode::DIRECT) {
+    flags |= O_DIRECT;
+  }
+#endif  // O_DIRECT
+
+  const int fd = open(path.c_str(), flags, 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), "open " + path);
+  }
+
+  return BinarySink(std::make_shared<details::BufferedWriter>(fd, true));
+}
+
+}  // namespace fn
+
+#endif  // FUNC_SINK_INL_H_
@@ -0,0 +1,206 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_SINK_H_
+#define FUNC_SINK_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "fn/string_view.h"
+
+namespace fn {
+
+// How files are written by View::to_file().
+enum class WriteMode {
+  // Through the page cache.
+  BUFFERED,
+  // Bypassing the page cache (O_DIRECT), for outputs too large to cache.
+  DIRECT,
+};
+
+// The size of each buffer of a sink, and the number of buffers.
+const size_t kSinkBufferSize = 1 << 20;
+const size_t kSinkBuffers = 4;
+
+namespace details {
+
+// Writes bytes to a file descriptor on a thread of its own. Bytes are copied to
+// page-aligned buffers, and full buffers are handed to the thread, which writes
+// all the buffers pending at once with writev. Memory use is constant.
+class BufferedWriter {
+ public:
+  // Writes to fd, which is closed along with the writer if owned.
+  BufferedWriter(int fd, bool owned);
+
+  // Closes the writer, ignoring errors.
+  ~BufferedWriter();
+
+  BufferedWriter(const BufferedWriter&) = delete;
+  BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+  void append(const void* data, size_t size) {
+    if (size <= static_cast<size_t>(end_ - pos_)) {
+      memcpy(pos_, data, size);
+      pos_ += size;
+      return;
+    }
+
+    append_slow(data, size);
+  }
+
+  // Writes the bytes appended so far and waits for all writes, then closes fd
+  // if owned. Throws std::system_error if a write failed.
+  void close();
+
+ private:
+  void append_slow(const void* data, size_t size);
+
+  // Hands the current buffer to the thread, and waits for the next one to be
+  // free.
+  void submit();
+
+  void run();
+
+  const int fd_;
+  const bool owned_;
+  char* buffers_[kSinkBuffers];
+  char* pos_;
+  char* end_;
+
+  // Buffers [written_, submitted_) (modulo kSinkBuffers) are being written.
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::thread thread_;
+  size_t submitted_;
+  size_t written_;
+  bool closed_;
+  std::exception_ptr error_;
+};
+
+}  // namespace details
+
+// A function writing the bytes of the trivially copyable elements it is called
+// with to a file descriptor, without a write per element:
+//
+//   auto sink = fn::binary_sink(fd);
+//   view >> sink;
+//   sink.close();
+//
+// Copies share the buffers, which are written when closed, or when the last
+// copy is destroyed if not closed (ignoring errors).
+class BinarySink {
+ public:
+  explicit BinarySink(std::shared_ptr<details::BufferedWriter> writer)
+      : writer_(std::move(writer)) {}
+
+  template <typename T>
+  void operator()(const T& e) const {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "BinarySink elements must be trivially copyable");
+    writer_->append(&e, sizeof(T));
+  }
+
+  // Writes the remaining bytes, and waits for all writes. Throws
+  // std::system_error if a write failed.
+  void close() const { writer_->close(); }
+
+ private:
+  std::shared_ptr<details::BufferedWriter> writer_;
+};
+
+// Returns a sink writing to fd, which it does not close.
+BinarySink binary_sink(int fd);
+
+// Returns a sink writing to the file at path, created or truncated. Throws
+// std::system_error if the file cannot be opened.
+BinarySink binary_sink(const std::string& path,
+                       WriteMode mode = WriteMode::BUFFERED);
+
+// A function writing the elements it is called with as text to a file
+// descriptor, one per line, without a write per element:
+//
+//   auto sink = fn::text_sink(1);
+//   _(counts) >> sink;
+//   sink.close();
+//
+// Numbers are formatted without locales, as printf does with %d or as
+// std::to_chars does for floating point numbers, chars and strings are written
+// as is, and pairs (e.g., from zip()) as their two members separated by the
+// separator, recursively. Like BinarySink, copies share the buffers.
+class TextSink {
+ public:
+  TextSink(std::shared_ptr<details::BufferedWriter> writer,
+           std::string separator, std::string terminator)
+      : writer_(std::move(writer)),
+        separator_(std::move(separator)),
+        terminator_(std::move(terminator)) {}
+
+  template <typename T>
+  void operator()(const T& e) const;
+
+  // Writes the remaining text, and waits for all writes. Throws
+  // std::system_error if a write failed.
+  void close() const { writer_->close(); }
+
+ private:
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value>::type write(T e) const;
+
+  template <typename T>
+  typename std::enable_if<std::is_floating_point<T>::value>::type write(
+      T e) const;
+
+  void write(char e) const { writer_->append(&e, 1); }
+  void write(const char* e) const { writer_->append(e, strlen(e)); }
+  void write(const std::string& e) const {
+    writer_->append(e.data(), e.size());
+  }
+
+  void write(const StringView& e) const {
+    writer_->append(e.data(), e.size());
+  }
+
+  template <typename A, typename B>
+  void write(const std::pair<A, B>& e) const;
+
+  std::shared_ptr<details::BufferedWriter> writer_;
+  std::string separator_;
+  std::string terminator_;
+};
+
+// Returns a sink writing to fd, which it does not close.
+TextSink text_sink(int fd, std::string separator = "\t",
+                   std::string terminator = "\n");
+
+// Returns a sink writing to the descriptor of f, after flushing it. Nothing
+// else should be written to f until the sink is closed.
+TextSink text_sink(FILE* f, std::string separator = "\t",
+                   std::string terminator = "\n");
+
+}  // namespace fn
+
+#include "fn/sink-inl.h"
+
+#endif  // FUNC_SINK_H_
@@ -0,0 +1,152 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_SMALL_VECTOR_INL_H_
+#define FUNC_SMALL_VECTOR_INL_H_
+
+#include <new>
+#include <utility>
+
+namespace fn {
+
+template <typename T, size_t N>
+SmallVector<T, N>::SmallVector() : size_(0) {}
+
+template <typename T, size_t N>
+SmallVector<T, N>::SmallVector(std::initializer_list<T> l) : size_(0) {
+  for (const auto& t : l) {
+    push_back(t);
+  }
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>::SmallVector(const SmallVector& that) : size_(0) {
+  assign(that);
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>::SmallVector(SmallVector&& that) : size_(0) {
+  assign(std::move(that));
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>::~SmallVector() {
+  clear();
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>& SmallVector<T, N>::operator=(const SmallVector& that) {
+  if (this != &that) {
+    clear();
+    assign(that);
+  }
+  return *this;
+}
+
+template <typename T, size_t N>
+SmallVector<T, N>& SmallVector<T, N>::operator=(SmallVector&& that) {
+  if (this != &that) {
+    clear();
+    assign(std::move(that));
+  }
+  return *this;
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::assign(const SmallVector& that) {
+  if (that.is_inline()) {
+    for (const auto& t : that) {
+      push_back(t);
+    }
+    return;
+  }
+
+  heap_ = that.heap_;
+  size_ = that.size_;
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::assign(SmallVector&& that) {
+  if (that.is_inline()) {
+    for (auto& t : that) {
+      push_back(std::move(t));
+    }
+  } else {
+    heap_ = std::move(that.heap_);
+    size_ = that.size_;
+  }
+
+  that.clear();
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::push_back(const T& t) {
+  push_back(T(t));
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::push_back(T&& t) {
+  if (size_ < N) {
+    new (&inline_[size_]) T(std::move(t));
+    size_++;
+    return;
+  }
+
+  if (size_ == N) {
+    spill(std::move(t));
+    return;
+  }
+
+  heap_.push_back(std::move(t));
+  size_++;
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::clear() {
+  if (is_inline()) {
+    for (size_t i = 0; i < size_; i++) {
+      data()[i].~T();
+    }
+  }
+
+  heap_.clear();
+  size_ = 0;
+}
+
+template <typename T, size_t N>
+void SmallVector<T, N>::spill(T&& t) {
+  // The inline elements are only destroyed once all of them are on the heap,
+  // so that they are kept if anything throws.
+  const auto inline_data = data();
+  try {
+    heap_.reserve(2 * N + 1);
+    for (size_t i = 0; i < size_; i++) {
+      heap_.push_back(std::move(inline_data[i]));
+    }
+
+    heap_.push_back(std::move(t));
+  } catch (...) {
+    heap_.clear();
+    throw;
+  }
+
+  for (size_t i = 0; i < size_; i++) {
+    inline_data[i].~T();
+  }
+  size_++;
+}
+
+}  // namespace fn
+
+#endif  // FUNC_SMALL_VECTOR_INL_H_
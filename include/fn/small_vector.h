@@ -0,0 +1,93 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_SMALL_VECTOR_H_
+#define FUNC_SMALL_VECTOR_H_
+
+#include <cstddef>
+
+#include <initializer_list>
+#include <type_traits>
+#include <vector>
+
+namespace fn {
+
+// A vector that keeps up to N elements inline, and only moves them to the heap
+// when it grows beyond N. Inline elements are constructed in place as they
+// are added, so T needs no default constructor. Useful as the result of flat_map functions that
+// produce a few elements per input:
+//
+//   _(&v).flat_map([](int i) { return fn::SmallVector<int, 2>{i, -i}; });
+template <typename T, size_t N = 8>
+class SmallVector {
+ public:
+  using value_type = T;
+  using size_type = size_t;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  SmallVector();
+  SmallVector(std::initializer_list<T> l);
+  SmallVector(const SmallVector& that);
+  SmallVector(SmallVector&& that);
+  ~SmallVector();
+
+  SmallVector& operator=(const SmallVector& that);
+  SmallVector& operator=(SmallVector&& that);
+
+  void push_back(const T& t);
+  void push_back(T&& t);
+  void clear();
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Whether the elements are stored inline.
+  bool is_inline() const { return size_ <= N; }
+
+  T* data() {
+    return is_inline() ? reinterpret_cast<T*>(inline_) : heap_.data();
+  }
+  const T* data() const {
+    return is_inline() ? reinterpret_cast<const T*>(inline_) : heap_.data();
+  }
+
+  T& operator[](size_t i) { return data()[i]; }
+  const T& operator[](size_t i) const { return data()[i]; }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + size_; }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size_; }
+
+ private:
+  // Moves the inline elements to the heap, followed by t.
+  void spill(T&& t);
+
+  // Copies or moves the elements of that, with this empty.
+  void assign(const SmallVector& that);
+  void assign(SmallVector&& that);
+
+  // Holds the first size_ elements while is_inline(), and nothing otherwise,
+  // in which case heap_ holds them all.
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type inline_[N];
+  std::vector<T> heap_;
+  size_t size_;
+};
+
+}  // namespace fn
+
+#include "fn/small_vector-inl.h"
+
+#endif  // FUNC_SMALL_VECTOR_H_
@@ -0,0 +1,51 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_SPAN_H_
+#define FUNC_SPAN_H_
+
+#include <cstddef>
+
+namespace fn {
+
+// A contiguous sequence of elements owned by someone else (e.g., an arena or a
+// mapped file). Spans are cheap to copy, so views over them never allocate.
+template <typename T>
+class Span {
+ public:
+  using value_type = T;
+  using size_type = size_t;
+  using iterator = const T*;
+  using const_iterator = const T*;
+
+  Span() : data_(nullptr), size_(0) {}
+  Span(const T* data, size_t size) : data_(data), size_(size) {}
+
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  const T& operator[](size_t i) const { return data_[i]; }
+
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+ private:
+  const T* data_;
+  size_t size_;
+};
+
+}  // namespace fn
+
+#endif  // FUNC_SPAN_H_
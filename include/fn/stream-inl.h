@@ -0,0 +1,221 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_STREAM_INL_H_
+#define FUNC_STREAM_INL_H_
+
+#include <cerrno>
+#include <cstring>
+
+#include <system_error>
+
+#include <unistd.h>
+
+namespace fn {
+namespace details {
+
+inline std::shared_ptr<BlockReader> BlockReader::start(int fd,
+                                                       size_t block_size) {
+  auto reader = std::make_shared<BlockReader>(fd, block_size);
+  reader->thread_ = std::thread([reader]() { reader->run(); });
+  return reader;
+}
+
+inline BlockReader::BlockReader(int fd, size_t block_size)
+    : fd_(fd),
+      block_size_(block_size),
+      sizes_{-1, -1},
+      lengths_{0, 0},
+      tails_{0, 0},
+      current_(-1),
+      done_(false),
+      stopped_(false) {}
+
+inline StringView BlockReader::next() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const int i = current_ < 0 ? 0 : 1 - current_;
+  if (current_ >= 0) {
+    sizes_[current_] = -1;
+    cond_.notify_all();
+  }
+
+  cond_.wait(lock, [&] { return sizes_[i] >= 0 || done_; });
+  if (sizes_[i] < 0) {
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+
+    return StringView();
+  }
+
+  current_ = i;
+  return StringView(buffers_[i].data(), sizes_[i]);
+}
+
+inline void BlockReader::stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stopped_ = true;
+  cond_.notify_all();
+  thread_.detach();
+}
+
+inline void BlockReader::run() {
+  try {
+    for (int i = 0;; i = 1 - i) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [&] { return sizes_[i] < 0 || stopped_; });
+        if (stopped_) {
+          break;
+        }
+      }
+
+      const bool eof = fill(i, 1 - i);
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (tails_[i] > 0) {
+        sizes_[i] = tails_[i];
+        cond_.notify_all();
+      }
+
+      if (eof) {
+        break;
+      }
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = std::current_exception();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  done_ = true;
+  cond_.notify_all();
+}
+
+inline bool BlockReader::fill(int i, int j) {
+  // The other buffer is not written to while its lines are processed, and its
+  // tail is not part of them.
+  auto& buffer = buffers_[i];
+  const size_t carried = lengths_[j] - tails_[j];
+  if (buffer.size() < std::max(block_size_, 2 * carried)) {
+    buffer.resize(std::max(block_size_, 2 * carried));
+  }
+
+  // The other buffer is still empty on the first fill.
+  if (carried > 0) {
+    memcpy(buffer.data(), buffers_[j].data() + tails_[j], carried);
+  }
+
+  size_t size = carried;
+  for (;;) {
+    const ssize_t n = read(fd_, buffer.data() + size, buffer.size() - size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0) {
+      throw std::system_error(errno, std::generic_category(), "read");
+    }
+
+    if (n == 0) {
+      // The last line may not end with '\n'.
+      lengths_[i] = size;
+      tails_[i] = size;
+      return true;
+    }
+
+    // Lines end at the last '\n', and the rest is carried to the next block.
+    // Blocks end after any read with a whole line, not to delay lines while
+    // waiting for a slow writer. Full buffers without a whole line grow.
+    const size_t begin = size;
+    size += n;
+    size_t lines = size;
+    while (lines > begin && buffer[lines - 1] != '\n') {
+      lines--;
+    }
+
+    if (lines > begin) {
+      lengths_[i] = size;
+      tails_[i] = lines;
+      return false;
+    }
+
+    if (size == buffer.size()) {
+      buffer.resize(2 * size);
+    }
+  }
+}
+
+}  // namespace details
+
+template <typename E>
+StreamLines<E>::Iterator::Iterator(
+    std::shared_ptr<details::BlockReader> reader)
+    : reader_(std::move(reader)), pos_(nullptr), end_(nullptr) {
+  find_line();
+}
+
+template <typename E>
+typename StreamLines<E>::Iterator& StreamLines<E>::Iterator::operator++() {
+  // Skips the line and its '\n', if any.
+  pos_ = line_.data() + line_.size();
+  pos_ += pos_ != end_;
+  find_line();
+  return *this;
+}
+
+template <typename E>
+void StreamLines<E>::Iterator::find_line() {
+  if (pos_ == end_ && reader_ != nullptr) {
+    const auto block = reader_->next();
+    pos_ = block.empty() ? nullptr : block.data();
+    end_ = block.empty() ? nullptr : block.data() + block.size();
+  }
+
+  if (pos_ == nullptr) {
+    line_ = E();
+    return;
+  }
+
+  auto nl = static_cast<const char*>(memchr(pos_, '\n', end_ - pos_));
+  line_ = E(pos_, (nl == nullptr ? end_ : nl) - pos_);
+}
+
+template <typename E>
+StreamLines<E>::StreamLines(int fd, size_t block_size)
+    : stream_(new Stream{fd, block_size, nullptr}) {}
+
+template <typename E>
+typename StreamLines<E>::Iterator StreamLines<E>::begin() const {
+  if (stream_->reader == nullptr) {
+    stream_->reader =
+        details::BlockReader::start(stream_->fd, stream_->block_size);
+  }
+
+  return Iterator(stream_->reader);
+}
+
+template <typename E>
+StreamLines<E>::Stream::~Stream() {
+  if (reader != nullptr) {
+    reader->stop();
+  }
+}
+
+inline StreamLines<> read_lines(int fd, size_t block_size) {
+  return StreamLines<>(fd, block_size);
+}
+
+}  // namespace fn
+
+#endif  // FUNC_STREAM_INL_H_
@@ -0,0 +1,151 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_STREAM_H_
+#define FUNC_STREAM_H_
+
+#include <cstddef>
+
+#include <condition_variable>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "fn/string_view.h"
+
+namespace fn {
+
+// The default number of bytes read from streams at a time.
+const size_t kStreamBlockSize = 2 << 20;
+
+namespace details {
+
+// Reads a file descriptor in blocks of whole lines on a thread of its own, so
+// that reads overlap with the processing of the previous block. There are two
+// buffers: one read into, and the other being processed. The partial line at
+// the end of a block is moved to the start of the next one, and buffers grow
+// to fit lines longer than a block.
+class BlockReader {
+ public:
+  // Starts reading fd. The reader is shared with its thread, which exits at
+  // the end of the stream, or at the end of the current read once stopped.
+  static std::shared_ptr<BlockReader> start(int fd, size_t block_size);
+
+  BlockReader(int fd, size_t block_size);
+
+  // Releases the current block, and returns the next one, or an empty block at
+  // the end of the stream. Throws std::system_error if a read fails.
+  StringView next();
+
+  // Stops reading without waiting for the thread.
+  void stop();
+
+ private:
+  void run();
+
+  // Reads into buffer i the partial line at the end of buffer j, then a block
+  // of whole lines. Returns true at the end of the stream.
+  bool fill(int i, int j);
+
+  const int fd_;
+  const size_t block_size_;
+  std::vector<char> buffers_[2];
+
+  // The size of the lines handed out from each buffer, or -1 for free buffers.
+  // Only the reader thread reads the bytes read into each buffer, and where
+  // their partial line starts.
+  long sizes_[2];
+  size_t lengths_[2];
+  size_t tails_[2];
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::thread thread_;
+  int current_;
+  bool done_;
+  bool stopped_;
+  std::exception_ptr error_;
+};
+
+}  // namespace details
+
+// The lines read from a file descriptor that cannot be mapped (e.g., a pipe or
+// a socket), as views of type E (e.g., StringView) on the blocks read, without
+// their '\n'. A line is valid until the lines of the next block are read.
+//
+// Reading starts at the first call to begin(), on a thread of its own. Lines
+// can only be iterated once: copies share the stream, and iterators are input
+// iterators.
+template <typename E = StringView>
+class StreamLines {
+ public:
+  class Iterator : public std::iterator<std::input_iterator_tag, E> {
+   public:
+    explicit Iterator(std::shared_ptr<details::BlockReader> reader);
+
+    const E& operator*() const { return line_; }
+    const E* operator->() const { return &line_; }
+
+    Iterator& operator++();
+
+    bool operator==(const Iterator& that) const { return pos_ == that.pos_; }
+    bool operator!=(const Iterator& that) const { return pos_ != that.pos_; }
+
+   private:
+    void find_line();
+
+    std::shared_ptr<details::BlockReader> reader_;
+    const char* pos_;
+    const char* end_;
+    E line_;
+  };
+
+  // For compability with stl.
+  using value_type = E;
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+
+  StreamLines(int fd, size_t block_size);
+
+  Iterator begin() const;
+  Iterator end() const { return Iterator(nullptr); }
+
+ private:
+  struct Stream {
+    ~Stream();
+
+    int fd;
+    size_t block_size;
+    std::shared_ptr<details::BlockReader> reader;
+  };
+
+  std::shared_ptr<Stream> stream_;
+};
+
+// Reads the lines of fd (by default, the standard input), for creating a view
+// on them:
+//
+//   auto errors = _(fn::read_lines()).filter(is_error).size();
+//
+// Lines are read in blocks of block_size bytes. fd is not closed.
+StreamLines<> read_lines(int fd = 0, size_t block_size = kStreamBlockSize);
+
+}  // namespace fn
+
+#include "fn/stream-inl.h"
+
+#endif  // FUNC_STREAM_H_
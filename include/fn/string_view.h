@@ -0,0 +1,119 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_STRING_VIEW_H_
+#define FUNC_STRING_VIEW_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace fn {
+
+// A sequence of characters owned by someone else (e.g., a mapped file), like
+// C++17's std::string_view. String views are cheap to copy, and producing them
+// never allocates.
+class StringView {
+ public:
+  using value_type = char;
+  using size_type = size_t;
+  using iterator = const char*;
+  using const_iterator = const char*;
+
+  static const size_t npos = static_cast<size_t>(-1);
+
+  StringView() : data_(nullptr), size_(0) {}
+  StringView(const char* data, size_t size) : data_(data), size_(size) {}
+  StringView(const char* s) : data_(s), size_(strlen(s)) {}
+  StringView(const std::string& s) : data_(s.data()), size_(s.size()) {}
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  char operator[](size_t i) const { return data_[i]; }
+
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+
+  // Returns the characters in [pos, pos + n), clamped to the view.
+  StringView substr(size_t pos, size_t n = npos) const {
+    pos = std::min(pos, size_);
+    return StringView(data_ + pos, std::min(n, size_ - pos));
+  }
+
+  // Returns the position of the first c at or after pos, or npos.
+  size_t find(char c, size_t pos = 0) const {
+    if (pos >= size_) {
+      return npos;
+    }
+
+    auto p = static_cast<const char*>(memchr(data_ + pos, c, size_ - pos));
+    return p == nullptr ? npos : p - data_;
+  }
+
+  std::string str() const { return std::string(data_, size_); }
+
+  int compare(const StringView& that) const {
+    const auto n = std::min(size_, that.size_);
+    const auto c = n == 0 ? 0 : memcmp(data_, that.data_, n);
+    if (c != 0) {
+      return c;
+    }
+
+    return size_ < that.size_ ? -1 : size_ > that.size_;
+  }
+
+  bool operator==(const StringView& that) const {
+    return size_ == that.size_ &&
+           (size_ == 0 || memcmp(data_, that.data_, size_) == 0);
+  }
+
+  bool operator!=(const StringView& that) const { return !(*this == that); }
+  bool operator<(const StringView& that) const { return compare(that) < 0; }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const StringView& s) {
+  return os.write(s.data(), s.size());
+}
+
+}  // namespace fn
+
+namespace std {
+
+// FNV-1a, so that string views can be used in unordered containers.
+template <>
+struct hash<fn::StringView> {
+  size_t operator()(const fn::StringView& s) const {
+    uint64_t h = 14695981039346656037ull;
+    for (auto c : s) {
+      h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    }
+
+    return static_cast<size_t>(h);
+  }
+};
+
+}  // namespace std
+
+#endif  // FUNC_STRING_VIEW_H_
@@ -0,0 +1,169 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_TOKENS_H_
+#define FUNC_TOKENS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <iterator>
+
+#include "fn/bitmap.h"
+#include "fn/byte_set.h"
+#include "fn/string_view.h"
+
+namespace fn {
+
+// The tokens of a string: its non-empty substrings separated by delimiters.
+// Tokens are found while iterating, and point into the string.
+class Tokens {
+ public:
+  class Iterator : public std::iterator<std::forward_iterator_tag, StringView> {
+   public:
+    Iterator(const char* pos, const char* end,
+             const details::ByteSet* delims);
+
+    const StringView& operator*() const { return token_; }
+    const StringView* operator->() const { return &token_; }
+
+    Iterator& operator++();
+    Iterator operator++(int);
+
+    bool operator==(const Iterator& that) const {
+      return token_.data() == that.token_.data();
+    }
+
+    bool operator!=(const Iterator& that) const {
+      return token_.data() != that.token_.data();
+    }
+
+   private:
+    void find_token(const char* pos);
+
+    const char* end_;
+    const details::ByteSet* delims_;
+    StringView token_;
+  };
+
+  // For compability with stl.
+  using value_type = StringView;
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+
+  Tokens(StringView text, const details::ByteSet& delims)
+      : text_(text), delims_(delims) {}
+
+  Iterator begin() const;
+  Iterator end() const;
+
+  // Calls g for each token. The delimiters are found 64 bytes at a time, and
+  // the tokens are the runs of bytes between them.
+  template <typename G>
+  void for_each(G& g) const;
+
+ private:
+  StringView text_;
+  details::ByteSet delims_;
+};
+
+namespace details {
+
+// The function of a flat_map stage splitting strings into tokens (see
+// View::split()).
+struct Tokenizer {
+  explicit Tokenizer(StringView delims) : delims(delims) {}
+
+  Tokens operator()(StringView s) const { return Tokens(s, delims); }
+
+  ByteSet delims;
+};
+
+}  // namespace details
+
+inline Tokens::Iterator::Iterator(const char* pos, const char* end,
+                                  const details::ByteSet* delims)
+    : end_(end), delims_(delims) {
+  find_token(pos);
+}
+
+inline Tokens::Iterator& Tokens::Iterator::operator++() {
+  find_token(token_.data() + token_.size());
+  return *this;
+}
+
+inline Tokens::Iterator Tokens::Iterator::operator++(int) {
+  auto cp = *this;
+  ++*this;
+  return cp;
+}
+
+inline void Tokens::Iterator::find_token(const char* pos) {
+  while (pos != end_ && delims_->contains(*pos)) {
+    pos++;
+  }
+
+  auto token_end = pos;
+  while (token_end != end_ && !delims_->contains(*token_end)) {
+    token_end++;
+  }
+
+  token_ = StringView(pos, token_end - pos);
+}
+
+inline Tokens::Iterator Tokens::begin() const {
+  return Iterator(text_.data(), text_.data() + text_.size(), &delims_);
+}
+
+inline Tokens::Iterator Tokens::end() const {
+  const auto end = text_.data() + text_.size();
+  return Iterator(end, end, &delims_);
+}
+
+template <typename G>
+void Tokens::for_each(G& g) const {
+  const char* text = text_.data();
+  const size_t size = text_.size();
+  const char* token = text;
+
+  // Tokens start and end where a byte is not classified like the previous
+  // one. Bytes past the end are delimiters, and so is the byte before the
+  // start.
+  uint64_t previous = 1;
+  for (size_t i = 0; i < size; i += details::kByteSetBlockSize) {
+    const size_t n = std::min(size - i, details::kByteSetBlockSize);
+    const uint64_t delims = delims_.mask(text + i, n);
+    uint64_t changes = delims ^ (delims << 1 | previous);
+    previous = delims >> 63;
+    while (changes != 0) {
+      const int bit = details::count_trailing_zeros(changes);
+      changes &= changes - 1;
+      const char* p = text + i + bit;
+      if (delims >> bit & 1) {
+        g(StringView(token, p - token));
+      } else {
+        token = p;
+      }
+    }
+  }
+
+  if (previous == 0) {
+    g(StringView(token, text + size - token));
+  }
+}
+
+}  // namespace fn
+
+#endif  // FUNC_TOKENS_H_
@@ -0,0 +1,83 @@
+// Copyright 2014, The Project fn Authors. All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License"); you may
+// not use this file except in compliance with the License. You may obtain
+// a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+// WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+// License for the specific language governing permissions and limitations
+// under the License.
+
+#ifndef FUNC_TEST_COUNTERS_H_
+#define FUNC_TEST_COUNTERS_H_
+
+#include <cstddef>
+
+#include <atomic>
+
+namespace fn {
+namespace test {
+
+// The number of calls to the global operator new and operator new[], which
+// are replaced by allocations.cc in the programs linking it. Threads started
+// by views (e.g., by async()) allocate too, so the count is atomic.
+inline std::atomic<size_t>& allocation_count() {
+  static std::atomic<size_t> count(0);
+  return count;
+}
+
+// An element counting how many times its instances are copied and moved, for
+// checking how many times a view copies its elements. Converts to int, so that
+// the benchmarks can run the same functions on ints and Counted.
+class Counted {
+ public:
+  Counted(int value = 0) : value_(value) {}
+
+  Counted(const Counted& that) : value_(that.value_) { copies()++; }
+  Counted(Counted&& that) noexcept : value_(that.value_) { moves()++; }
+
+  Counted& operator=(const Counted& that) {
+    value_ = that.value_;
+    copies()++;
+    return *this;
+  }
+
+  Counted& operator=(Counted&& that) noexcept {
+    value_ = that.value_;
+    moves()++;
+    return *this;
+  }
+
+  int value() const { return value_; }
+  operator int() const { return value_; }
+
+  bool operator==(const Counted& that) const { return value_ == that.value_; }
+  bool operator!=(const Counted& that) const { return value_ != that.value_; }
+
+  static size_t& copies() {
+    static size_t copies = 0;
+    return copies;
+  }
+
+  static size_t& moves() {
+    static size_t moves = 0;
+    return moves;
+  }
+
+  static void reset() {
+    copies() = 0;
+    moves() = 0;
+  }
+
+ private:
+  int value_;
+};
+
+}  // namespace test
+}  // namespace fn
+
+#endif  // FUNC_TEST_COUNTERS_H_
@@ -18,6 +18,8 @@
 #include <iostream>
 #include <string>
 
+#include "test/counters.h"
+
 namespace fn {
 namespace test {
 
@@ -114,6 +116,26 @@ void run_all_tests() {
   }
 }
 
+// Counts the heap allocations performed during its lifetime, so that tests can
+// check how much a piece of code allocates:
+//
+//   fn::test::Allocations allocations;
+//   view.for_each(f);
+//   EXPECT_EQ(size_t(0), allocations.count(), "for_each should not allocate.");
+class Allocations {
+ public:
+  Allocations() : start_(allocation_count()) {}
+
+  size_t count() const { return allocation_count() - start_; }
+
+ private:
+  size_t start_;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const Counted& c) {
+  return os << "Counted(" << c.value() << ")";
+}
+
 }  // namespace test
 }  // namespace fn
 
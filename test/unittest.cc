@@ -12,13 +12,28 @@
 // License for the specific language governing permissions and limitations
 // under the License.
 
+#include <cstdio>
+#include <cstdlib>
+
 #include <algorithm>
+#include <limits>
+#include <system_error>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include <unordered_map>
 #include <utility>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "fn/range.h"
+#include "fn/csv.h"
+#include "fn/files.h"
 #include "fn/fn.h"
+#include "fn/lines.h"
+#include "fn/records.h"
+#include "fn/stream.h"
 #include "test/test.h"
 
 using std::make_pair;
@@ -28,6 +43,8 @@ using std::unordered_map;
 
 using fn::_;
 using fn::range;
+using fn::test::Allocations;
+using fn::test::Counted;
 
 TEST(Basic, Map) {
   int last = 0;
@@ -37,6 +54,22 @@ TEST(Basic, Map) {
   });
 
   EXPECT_EQ(5, last, "Wrong number of elements visited.");
+
+  auto doubled = _({1, 2, 3, 4, 5}).map([](int i) { return i * 2; });
+  Allocations allocations;
+  auto sum = 0;
+  doubled.for_each([&sum](int i) { sum += i; });
+  EXPECT_EQ(30, sum, "");
+  EXPECT_EQ(size_t(0), allocations.count(), "Mapping should not allocate.");
+
+  vector<Counted> counted{1, 2, 3};
+  Counted::reset();
+  auto mapped = _(&counted).map([](const Counted& c) {
+    return Counted(c.value() * 2);
+  }).as_vector();
+  EXPECT_EQ(Counted(6), mapped[2], "");
+  EXPECT_EQ(counted.size(), Counted::copies(),
+            "Mapped elements should be copied once into the vector.");
 }
 
 TEST(Basic, FlatMap) {
@@ -49,6 +82,118 @@ TEST(Basic, FlatMap) {
     EXPECT_EQ(i + 1, v[i * 2], "");
     EXPECT_EQ((i + 1) * 10, v[i * 2 + 1], "");
   }
+
+  vector<int> roots{1, 2, 3, 4, 5};
+  Allocations allocations;
+  auto sum = 0;
+  _(&roots).flat_map([](int i) { return std::vector<int>{i, i * 10}; })
+      .for_each([&sum](int i) { sum += i; });
+  EXPECT_EQ(165, sum, "");
+  EXPECT_EQ(roots.size(), allocations.count(),
+            "Only the inner vectors should be allocated.");
+}
+
+TEST(FlatMap, InnerViews) {
+  auto v = _(range(1, 4)).flat_map([](int i) {
+    return _(range(0, i)).map([i](int j) { return i * 10 + j; });
+  });
+
+  vector<int> expected{10, 20, 21, 30, 31, 32};
+  EXPECT_TRUE(expected == v.as_vector(), "Incorrect flattened view.");
+
+  vector<int> iterated;
+  for (auto i : v) {
+    iterated.push_back(i);
+  }
+  EXPECT_TRUE(expected == iterated, "Iterators should flatten inner views.");
+}
+
+TEST(FlatMap, IteratorPairs) {
+  vector<vector<int>> vs{{1, 2}, {}, {3}, {}};
+  auto v = _(&vs).flat_map([](const vector<int>& i) {
+    return make_pair(i.begin(), i.end());
+  });
+
+  vector<int> expected{1, 2, 3};
+  EXPECT_TRUE(expected == v.as_vector(), "Incorrect flattened view.");
+
+  vector<int> iterated;
+  for (auto i : v) {
+    iterated.push_back(i);
+  }
+  EXPECT_TRUE(expected == iterated, "Iterators should skip empty pairs.");
+}
+
+TEST(FlatMap, SmallVector) {
+  auto v = _({1, 2, 3}).flat_map([](int i) {
+    fn::SmallVector<int, 2> s;
+    for (auto j = 0; j < i; j++) {
+      s.push_back(i);
+    }
+    return s;
+  });
+
+  vector<int> expected{1, 2, 2, 3, 3, 3};
+  EXPECT_TRUE(expected == v.as_vector(), "Incorrect flattened view.");
+
+  auto count = 0;
+  for (auto i = v.begin(), e = v.end(); i != e; ++i) {
+    auto cp = i;
+    EXPECT_EQ(expected[count], *cp, "Copied iterators should not move.");
+    count++;
+  }
+  EXPECT_EQ(6, count, "There should be 6 elements in the view.");
+
+  auto calls = 0;
+  auto counted = _({1, 2, 3}).flat_map([&calls](int i) {
+    calls++;
+    return vector<int>(i, i);
+  });
+  count = 0;
+  for (auto i = counted.begin(), e = counted.end(); i != e; i++) {
+    count += *i;
+  }
+  EXPECT_EQ(14, count, "");
+  EXPECT_EQ(3, calls, "Copies should not map the outer element again.");
+
+  // Inner containers of temporaries are copied too.
+  calls = 0;
+  auto mapped = _({1, 2, 3}).map([](int i) { return i + 1; });
+  auto flattened = mapped.flat_map([&calls](int i) {
+    calls++;
+    return vector<int>(i, i);
+  });
+  count = 0;
+  for (auto i = flattened.begin(), e = flattened.end(); i != e; i++) {
+    count += *i;
+  }
+  EXPECT_EQ(29, count, "");
+  EXPECT_EQ(3, calls, "");
+
+  // Elements are constructed inline as they are added.
+  struct NoDefault {
+    explicit NoDefault(int value) : value(value) {}
+    int value;
+  };
+  fn::SmallVector<NoDefault, 2> no_default;
+  for (int i = 0; i < 3; i++) {
+    no_default.push_back(NoDefault(i));
+  }
+  auto copy = no_default;
+  EXPECT_EQ(2, copy[2].value, "");
+
+  fn::SmallVector<std::string, 2> strings{"a", "b"};
+  auto moved = std::move(strings);
+  strings = moved;
+  strings.push_back("c");
+  EXPECT_EQ(std::string("b"), moved[1], "");
+  EXPECT_EQ(std::string("c"), strings[2], "");
+
+  fn::SmallVector<int, 2> s{1, 2};
+  EXPECT_TRUE(s.is_inline(), "Two elements should be stored inline.");
+  s.push_back(3);
+  EXPECT_FALSE(s.is_inline(), "Three elements should be stored on heap.");
+  EXPECT_EQ(1 + 2 + 3, _(vector<int>(s.begin(), s.end())).sum(), "");
 }
 
 TEST(Basic, Filter) {
@@ -104,6 +249,15 @@ TEST(Basic, Zip) {
     count++;
   }
   EXPECT_EQ(size_t(5), count, "There should be 5 elements zipped.");
+
+  // The left side is copied once to materialize it, each side once into the
+  // pairs, and the pairs once into the vector.
+  vector<Counted> counted{1, 2, 3};
+  Counted::reset();
+  auto pairs = _(&counted).zip(_(&counted)).as_vector();
+  EXPECT_EQ(counted.size(), pairs.size(), "");
+  EXPECT_EQ(5 * counted.size(), Counted::copies(),
+            "Zipping should not copy the elements more often.");
 }
 
 TEST(Basic, First) {
@@ -191,6 +345,23 @@ TEST(Basic, InPlaceEvaluate) {
   // Syntax sugar.
   _({0, 1, 2, 1, 2}).skip_until([](int i) { return i > 1; }) >> &results;
   validate_and_reset_results();
+
+  // No allocations when the container has enough capacity.
+  auto view = _({0, 1, 2, 1, 2}).skip_until([](int i) { return i > 1; });
+  results.reserve(3);
+  Allocations allocations;
+  view.evaluate(&results);
+  EXPECT_EQ(size_t(0), allocations.count(), "Evaluating should not allocate.");
+  validate_and_reset_results();
+
+  vector<Counted> counted{0, 1, 2, 1, 2};
+  vector<Counted> counted_results;
+  counted_results.reserve(3);
+  Counted::reset();
+  _(&counted).skip_until([](const Counted& c) { return c.value() > 1; })
+      .evaluate(&counted_results);
+  EXPECT_EQ(size_t(3), Counted::copies(),
+            "Each result should be copied once, and nothing else copied.");
 }
 
 TEST(Basic, InPlaceEvaluateMap) {
@@ -236,7 +407,11 @@ TEST(Basic, Ref) {
   v.push_back(1);
   v.push_back(2);
 
-  auto r = _(&v).map([](int i) { return i * 2; }).as_vector();
+  Allocations allocations;
+  auto view = _(&v).map([](int i) { return i * 2; });
+  EXPECT_EQ(size_t(0), allocations.count(), "References should not allocate.");
+
+  auto r = view.as_vector();
   EXPECT_EQ(size_t(2), r.size(), "Expected two items in the results.");
   EXPECT_EQ(2, r[0], "");
   EXPECT_EQ(4, r[1], "");
@@ -294,6 +469,925 @@ TEST(Range, Functional) {
   EXPECT_EQ(2, v[0], "The first element is not correctly mapped.");
 }
 
+TEST(Arena, Evaluate) {
+  fn::Arena arena(1024);
+  vector<int> v{1, 2, 3, 4, 5, 6};
+
+  auto evens = _(v, &arena).filter([](int i) { return i % 2 == 0; });
+  auto r = evens.as_vector(&arena);
+  EXPECT_EQ(size_t(3), r.size(), "There are 3 even numbers in the view.");
+  EXPECT_EQ(2, r[0], "");
+  EXPECT_EQ(6, r[2], "");
+  EXPECT_TRUE(r.get_allocator().arena() == &arena,
+              "The results should be allocated in the arena.");
+
+  auto s = evens.as_set(&arena);
+  EXPECT_EQ(size_t(3), s.size(), "There are 3 distinct even numbers.");
+
+  auto m = _(v, &arena)
+               .map([](int i) { return make_pair(i, i * i); })
+               .as_map<int, int>(&arena);
+  EXPECT_EQ(25, m[5], "Incorrectly mapped.");
+
+  fn::ArenaList<int> l{fn::ArenaAllocator<int>(&arena)};
+  evens >> &l;
+  EXPECT_EQ(size_t(3), l.size(), "In-place evaluation should append 3 items.");
+
+  EXPECT_TRUE(arena.used() > 0, "The arena should have been used.");
+  arena.reset();
+  EXPECT_EQ(size_t(0), arena.used(), "Reset should free everything.");
+
+  auto first = arena.allocate(16);
+  arena.allocate(1 << 20);
+  arena.reset();
+  EXPECT_TRUE(arena.allocate(16) == first,
+              "Reset should keep the first block, not the large one.");
+}
+
+TEST(Arena, Scope) {
+  fn::Arena arena;
+  EXPECT_TRUE(fn::Arena::current() == nullptr, "There should be no arena.");
+  {
+    fn::Arena::Scope scope(&arena);
+    EXPECT_TRUE(fn::Arena::current() == &arena, "The arena is not installed.");
+
+    auto lst = vector<int>({0, 1, 2, 3, 4});
+    auto zv = _(&lst).zip(_(&lst)).as_vector();
+    EXPECT_EQ(size_t(5), zv.size(), "There should be 5 elements zipped.");
+    EXPECT_EQ(4, zv[4].first, "Incorrect first element.");
+    EXPECT_TRUE(arena.used() > 0, "Zip should use the arena of the scope.");
+  }
+  EXPECT_TRUE(fn::Arena::current() == nullptr, "The scope did not clean up.");
+}
+
+TEST(Columns, Projection) {
+  vector<long> ts{10, 20, 30, 40};
+  vector<int> user{1, 2, 1, 1};
+  vector<double> value{0.5, 1.5, 2.5, 3.5};
+
+  auto cols = fn::columns(ts, user, value);
+  using Row = decltype(cols)::value_type;
+
+  auto total = _(cols)
+                   .filter([](const Row& r) { return r.get<1>() == 1; })
+                   .filter([](const Row& r) { return r.get<0>() > 10; })
+                   .map([](const Row& r) { return r.get<2>(); })
+                   .sum();
+  EXPECT_EQ(2.5 + 3.5, total, "Incorrect sum of the filtered values.");
+
+  auto values = _(cols).map(fn::column<2>());
+  EXPECT_TRUE((std::is_same<decltype(values),
+                            fn::View<fn::Span, double>>::value),
+              "Projections should result in a view on the column.");
+  EXPECT_TRUE(values.begin() != values.end(), "The column is empty.");
+  EXPECT_EQ(value.data(), &*values.begin(), "The column should not be copied.");
+  EXPECT_EQ(0.5 + 1.5 + 2.5 + 3.5, values.sum(), "Incorrect sum.");
+
+  // Rows outlive the views they were evaluated from, along with the columns.
+  auto rows = _(cols)
+                  .filter([](const Row& r) { return r.get<1>() == 1; })
+                  .as_vector();
+  EXPECT_EQ(sizeof(void*) + sizeof(size_t), sizeof(Row),
+            "Rows should only hold a pointer and an index.");
+  EXPECT_EQ(size_t(3), rows.size(), "");
+  EXPECT_EQ(40L, rows[2].get<0>(), "");
+  EXPECT_EQ(3.5, rows[2].get<2>(), "");
+}
+
+TEST(Expr, Filter) {
+  using namespace fn::placeholders;
+
+  vector<int> v;
+  for (auto i = 1; i < 1000; i++) {
+    v.push_back(i);
+  }
+
+  auto lambda = _(&v).filter([](int i) { return i % 3 == 0 || i % 5 == 0; });
+  auto expr = _(&v).filter(_1 % 3 == 0 || _1 % 5 == 0);
+  EXPECT_EQ(233168, expr.sum(), "Incorrect sum of multiples of 3 or 5.");
+  EXPECT_TRUE(lambda.as_vector() == expr.as_vector(),
+              "Expressions should filter the same elements as lambdas.");
+
+  auto between = _(&v).filter(_1 > 10).filter(_1 < 100);
+  EXPECT_TRUE(fn::details::is_expression<decltype(between)::Func>::value,
+              "Filters of expressions should be fused into an expression.");
+  EXPECT_EQ(size_t(89), between.size(), "There are 89 numbers in (10, 100).");
+
+  // Guarded divisions should never be evaluated for the filtered elements.
+  vector<int> z{0, 1, 0, 2};
+  auto guarded = _(&z).filter(_1 != 0 && 10 / _1 > 5).as_vector();
+  EXPECT_EQ(size_t(1), guarded.size(), "Only 1 is selected.");
+  EXPECT_EQ(1, guarded[0], "");
+
+  auto first = _(range(1, 10)).filter(_1 % 4 == 0).first();
+  EXPECT_EQ(4, first, "Expressions should also work on other roots.");
+}
+
+TEST(Expr, Map) {
+  using namespace fn::placeholders;
+
+  vector<int> v{1, 2, 3, 4, 5};
+  auto r = _(&v).map(_1 * 2 + 1).map(-_1).as_vector();
+  EXPECT_EQ(size_t(5), r.size(), "Map should not drop elements.");
+  for (size_t i = 0; i < r.size(); i++) {
+    EXPECT_EQ(-(v[i] * 2 + 1), r[i], "Incorrectly mapped.");
+  }
+
+  EXPECT_EQ(15, _(&v).reduce(_1 + _2), "Incorrect sum.");
+}
+
+TEST(Fusion, AdjacentStages) {
+  auto root = _({1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+  auto v = root.filter([](int i) { return i > 1; })
+               .filter([](int i) { return i % 2 == 0; })
+               .map([](int i) { return i * 3; })
+               .map([](int i) { return i + 1; })
+               .filter([](int i) { return i < 30; })
+               .filter([](int i) { return i != 13; });
+
+  // The filters are fused into one stage, and the maps and the filters that
+  // follow them are fused into another.
+  using RootView = decltype(root);
+  EXPECT_TRUE((std::is_same<RootView, decltype(v)::PView::PView>::value),
+              "The stages should be fused into two stages.");
+  EXPECT_TRUE(fn::details::FuncType::MAP_FILTER == decltype(v)::func_type,
+              "The last stage should be a map-filter stage.");
+
+  auto r = v.as_vector();
+  EXPECT_EQ(size_t(3), r.size(), "There should be 3 elements in the view.");
+  EXPECT_EQ(7, r[0], "");
+  EXPECT_EQ(19, r[1], "");
+  EXPECT_EQ(25, r[2], "");
+
+  auto i = 0;
+  for (auto e : v) {
+    EXPECT_EQ(r[i++], e, "Iterators should produce the same elements.");
+  }
+  EXPECT_EQ(3, i, "Wrong number of elements iterated.");
+  EXPECT_EQ(7, v.first(), "The first element should be 7.");
+}
+
+namespace {
+
+// A timestamp counting the number of comparisons made.
+struct Stamp {
+  static int comparisons;
+
+  Stamp(int v = 0) : value(v) {}  // NOLINT
+
+  bool operator<(const Stamp& that) const {
+    comparisons++;
+    return value < that.value;
+  }
+
+  bool operator==(const Stamp& that) const { return value == that.value; }
+
+  int value;
+};
+
+int Stamp::comparisons = 0;
+
+}  // namespace
+
+TEST(Sorted, Between) {
+  vector<Stamp> v;
+  for (auto i = 0; i < 1024; i++) {
+    v.push_back(Stamp(i * 2));
+  }
+
+  auto window = _(fn::sorted(&v)).filter(fn::between(Stamp(100), Stamp(119)));
+  EXPECT_TRUE(decltype(window)::sorted, "Filters should preserve the order.");
+
+  Stamp::comparisons = 0;
+  auto r = window.as_vector();
+  EXPECT_EQ(size_t(10), r.size(), "There are 10 stamps in [100, 119].");
+  EXPECT_EQ(100, r.front().value, "");
+  EXPECT_EQ(118, r.back().value, "");
+  EXPECT_TRUE(Stamp::comparisons < 64,
+              "The range should be found using a binary search.");
+
+  // Range filters are not fused with other filters.
+  auto odd = _(fn::sorted(&v))
+                 .filter([](const Stamp& s) { return s.value % 4 == 0; })
+                 .filter(fn::between(Stamp(100), Stamp(119)))
+                 .filter([](const Stamp& s) { return s.value != 108; });
+  Stamp::comparisons = 0;
+  EXPECT_EQ(size_t(4), odd.size(), "100, 104, 112 and 116 are selected.");
+  EXPECT_TRUE(Stamp::comparisons < 64,
+              "The range should be found using a binary search.");
+
+  auto unsorted = _(&v).filter(fn::between(Stamp(100), Stamp(119)));
+  EXPECT_FALSE(decltype(unsorted)::sorted, "The root is not sorted.");
+  EXPECT_EQ(size_t(10), unsorted.size(), "Unsorted views are scanned.");
+}
+
+TEST(Sorted, Aggregates) {
+  vector<Stamp> v{Stamp(1), Stamp(3), Stamp(3), Stamp(5), Stamp(9)};
+  auto sorted = _(fn::sorted(&v));
+
+  Stamp::comparisons = 0;
+  EXPECT_EQ(1, sorted.min().value, "Incorrect minimum.");
+  EXPECT_EQ(9, sorted.max().value, "Incorrect maximum.");
+  EXPECT_EQ(9, sorted.last().value, "Incorrect last element.");
+  EXPECT_EQ(0, Stamp::comparisons, "Sorted roots should not be compared.");
+
+  auto distinct = sorted.distinct();
+  EXPECT_EQ(size_t(4), distinct.size(), "There are 4 distinct stamps.");
+  EXPECT_EQ(0, Stamp::comparisons, "Distinct should compare adjacent values.");
+
+  auto skipped = sorted.skip_until([](const Stamp& s) { return s.value > 2; });
+  EXPECT_TRUE(decltype(skipped)::sorted, "Skipping should preserve the order.");
+  EXPECT_EQ(3, skipped.min().value, "Incorrect minimum after skipping.");
+
+  auto mapped = sorted.map([](const Stamp& s) { return -s.value; });
+  EXPECT_FALSE(decltype(mapped)::sorted, "Maps do not preserve the order.");
+  EXPECT_EQ(-9, mapped.min(), "Incorrect minimum after mapping.");
+
+  auto s = _({5, 1, 4, 1, 3}).sort();
+  EXPECT_TRUE(decltype(s)::sorted, "Sorted views should be sorted.");
+  EXPECT_EQ(1, s.first(), "");
+  EXPECT_EQ(5, s.last(), "");
+  EXPECT_EQ(size_t(4), _({5, 1, 4, 1, 3}).distinct().size(),
+            "There are 4 distinct values.");
+  auto parity = _({5, 1, 4, 1, 3}).distinct([](int a, int b) {
+    return a % 2 == b % 2;
+  });
+  EXPECT_TRUE(parity == vector<int>({5, 4}),
+              "Values equal under eq need not be adjacent once sorted.");
+  EXPECT_EQ(5, _({5, 1, 4, 1, 3}).sort(std::greater<int>()).first(),
+            "Sort should use the comparator.");
+}
+
+TEST(Bitmap, Filter) {
+  vector<int> v;
+  for (auto i = 0; i < 10000; i++) {
+    v.push_back(i);
+  }
+
+  auto calls = 0;
+  auto scalar = _(&v).filter([](int i) { return i % 2 == 0; })
+                    .filter([](int i) { return i % 3 == 0; })
+                    .filter([&calls](int i) {
+                      calls++;
+                      return i % 5 == 0;
+                    });
+  auto bitmap = scalar.bitmap().filter([](int i) { return i > 100; });
+  using B = decltype(bitmap);
+  EXPECT_TRUE((fn::details::is_bitmap_stage<B::PView, B::Func>::value),
+              "Filters after bitmap() should be fused into the bitmap.");
+
+  auto expected = scalar.filter([](int i) { return i > 100; }).as_vector();
+  calls = 0;
+  auto actual = bitmap.map([](int i) { return i; }).as_vector();
+  EXPECT_TRUE(expected == actual, "Bitmaps should select the same elements.");
+  EXPECT_EQ(1667, calls, "Predicates are only evaluated for set bits.");
+  EXPECT_EQ(expected.size(), bitmap.size(), "Incorrect count of set bits.");
+
+  auto i = 0;
+  for (auto e : bitmap) {
+    EXPECT_EQ(expected[i++], e, "Iterators should produce the same elements.");
+  }
+
+  vector<int> odd{1, 3, 5};
+  EXPECT_EQ(size_t(0),
+            _(&odd).filter([](int i) { return i % 2 == 0; }).bitmap().size(),
+            "No bits should be set.");
+}
+
+TEST(Adaptive, Reorder) {
+  vector<int> v;
+  for (auto i = 0; i < 200000; i++) {
+    v.push_back(i);
+  }
+
+  auto slow_calls = 0;
+  auto slow = [&slow_calls](int i) {
+    slow_calls++;
+    return i >= 0;
+  };
+  auto filtered = _(&v).filter(slow)
+                      .filter([](int i) { return i % 100 == 0; })
+                      .filter([](int i) { return i % 3 == 0; });
+
+  auto expected = filtered.as_vector();
+  EXPECT_EQ(size_t(200000), size_t(slow_calls), "Filters run in order.");
+
+  slow_calls = 0;
+  auto adaptive = filtered.adaptive().filter([](int i) { return i > 10; });
+  auto actual = adaptive.as_vector();
+  EXPECT_EQ(expected.size() - 1, actual.size(), "Zero should be filtered.");
+  EXPECT_TRUE(std::equal(actual.begin(), actual.end(), expected.begin() + 1),
+              "Adaptive filters should select the same elements.");
+  EXPECT_TRUE(slow_calls < 20000,
+              "The selective predicates should be evaluated first.");
+}
+
+TEST(Adaptive, Expressions) {
+  using namespace fn::placeholders;
+
+  vector<int> v;
+  for (auto i = 0; i < 200000; i++) {
+    v.push_back(i);
+  }
+
+  auto filtered = _(&v).filter(_1 >= 0).filter(_1 % 100 == 0)
+                      .filter(_1 % 3 == 0);
+  auto adaptive = filtered.adaptive();
+  using Pred = decltype(adaptive)::Func::Pred;
+  EXPECT_EQ(size_t(3),
+            std::tuple_size<fn::details::Flattened<Pred>::type>::value,
+            "Each fused expression filter should be reordered on its own.");
+  EXPECT_TRUE(filtered.as_vector() == adaptive.as_vector(),
+              "Adaptive filters should select the same elements.");
+}
+
+TEST(Profile, Stages) {
+  vector<int> v;
+  for (auto i = 0; i < 1000; i++) {
+    v.push_back(i);
+  }
+
+  auto view = _(&v).filter([](int i) { return i % 2 == 0; })
+                  .map([](int i) { return i / 2; })
+                  .skip_until([](int i) { return i >= 100; });
+
+  fn::Profile profile;
+  auto profiled = view.profile(&profile);
+  EXPECT_TRUE(view.as_vector() == profiled.as_vector(),
+              "Profiling should not change the elements.");
+
+  const auto& stages = profile.stages();
+  EXPECT_EQ(size_t(3), stages.size(), "There should be one probe per stage.");
+  EXPECT_EQ(std::string("FILTER"), stages[0].type, "");
+  EXPECT_EQ(size_t(1000), stages[0].in, "");
+  EXPECT_EQ(size_t(500), stages[0].out, "");
+  EXPECT_EQ(0.5, stages[0].selectivity(), "");
+  EXPECT_EQ(std::string("MAP"), stages[1].type, "");
+  EXPECT_EQ(size_t(500), stages[1].out, "");
+  EXPECT_EQ(std::string("SKIP"), stages[2].type, "");
+  EXPECT_EQ(size_t(3), stages[2].position, "");
+  EXPECT_EQ(size_t(400), stages[2].out, "");
+  EXPECT_TRUE(profile.nanos() > 0, "The evaluation should be timed.");
+
+  auto total = profile.sink_nanos();
+  for (const auto& s : stages) {
+    total += s.nanos;
+  }
+
+  EXPECT_TRUE(total <= profile.nanos() * 1.01,
+              "Stages should not take more than the evaluation.");
+
+  profiled.size();
+  EXPECT_EQ(size_t(2000), profile.stages()[0].in, "Evaluations add up.");
+  EXPECT_TRUE(profile.json().find("\"type\": \"SKIP\"") != std::string::npos,
+              "");
+
+  fn::Profile pairs_profile;
+  auto pairs = _(&v).map([](int i) { return std::make_pair(i, -i); })
+                   .filter([](std::pair<int, int> p) { return p.first > 0; })
+                   .profile(&pairs_profile);
+  auto it = pairs.begin();
+  auto first = it++;
+  EXPECT_EQ(1, first->first, "Postfix increments return the prior position.");
+  EXPECT_EQ(-2, it->second, "");
+  auto doubled = _(&v).map([](int i) { return i * 2; }).profile(&pairs_profile);
+  EXPECT_EQ(2, *++doubled.begin(), "Mapped elements are passed by value.");
+}
+
+TEST(Explain, Plan) {
+  vector<int> v = {1, 2, 3, 4};
+  auto plan = _(&v).filter([](int i) { return i % 2 == 0; })
+                  .map([](int i) { return i * 2; })
+                  .explain();
+  EXPECT_EQ(0u, plan.find("MAP (rows <= 4)\n  FILTER (rows <= 4)\n    root "),
+            "Stages should be listed from the last one.");
+  EXPECT_TRUE(plan.find("by Ref (rows = 4)\n") != std::string::npos,
+              "The root should show its policy and size.");
+
+  plan = _(v).map([](int i) { return i; }).zip(_(&v)).explain();
+  EXPECT_EQ(0u, plan.find("ZIP (rows = 4): warning:"),
+            "Zips materialize their left side.");
+  EXPECT_TRUE(plan.find("by Copy (rows = 4): warning:") != std::string::npos,
+              "Copied roots should be flagged.");
+}
+
+// Writes content to a new temporary file, and returns its path.
+std::string temp_file(const std::string& content) {
+  char path[] = "/tmp/fn_test_XXXXXX";
+  const int fd = mkstemp(path);
+  FILE* f = fdopen(fd, "w");
+  fwrite(content.data(), 1, content.size(), f);
+  fclose(f);
+  return path;
+}
+
+TEST(Lines, Mmap) {
+  const auto path = temp_file("ERROR a\nok\n\nERROR b\nlast");
+  auto lines = fn::mmap_lines(path);
+  EXPECT_EQ(size_t(5), lines.size(), "The last line has no newline.");
+
+  auto is_error = [](fn::StringView line) {
+    return line.substr(0, 5) == "ERROR";
+  };
+  auto errors = _(lines).filter(is_error).as_vector();
+  EXPECT_EQ(size_t(2), errors.size(), "");
+  EXPECT_EQ(std::string("ERROR b"), errors[1].str(), "");
+
+  auto sizes = _(lines).map([](fn::StringView l) { return l.size(); });
+  EXPECT_EQ(size_t(20), sizes.sum(), "Newlines should not be included.");
+
+  size_t parts = 0;
+  size_t split = 0;
+  for (const auto& part : lines.split(3)) {
+    parts++;
+    split += _(part).size();
+  }
+
+  EXPECT_TRUE(parts > 1, "The lines should be split.");
+  EXPECT_EQ(lines.size(), split, "Parts should have all the lines once.");
+
+  // Lines are counted once, by whichever thread asks first.
+  auto uncounted = fn::mmap_lines(path);
+  size_t counted = 0;
+  std::thread counter([&]() { counted = uncounted.size(); });
+  EXPECT_EQ(size_t(5), uncounted.size(), "");
+  counter.join();
+  EXPECT_EQ(size_t(5), counted, "");
+  auto copy = uncounted;
+  EXPECT_EQ(size_t(5), copy.size(), "Copies should keep the count.");
+
+  remove(path.c_str());
+  auto thrown = false;
+  try {
+    fn::mmap_lines(path);
+  } catch (const std::system_error&) {
+    thrown = true;
+  }
+
+  EXPECT_TRUE(thrown, "Missing files should throw.");
+}
+
+TEST(Records, Mmap) {
+  using namespace fn::placeholders;
+
+  // A header of 8 bytes, 100 ints and 3 bytes of a footer.
+  std::string content(8, 'h');
+  for (int i = 0; i < 100; i++) {
+    content.append(reinterpret_cast<const char*>(&i), sizeof(i));
+  }
+
+  const auto path = temp_file(content + "end");
+  auto records = fn::records<int>(path, 8);
+  EXPECT_EQ(size_t(100), records.size(), "Partial records are ignored.");
+  EXPECT_EQ(4950, _(records).sum(), "");
+  EXPECT_EQ(size_t(50), _(records).filter(_1 % 2 == 0).size(), "");
+
+  auto middle = records.drop(10).take(20);
+  EXPECT_EQ(size_t(20), middle.size(), "");
+  EXPECT_EQ(10, middle[0], "");
+  EXPECT_EQ(size_t(0), records.drop(1000).size(), "");
+
+  auto parts = records.split(3);
+  EXPECT_EQ(size_t(3), parts.size(), "");
+  EXPECT_EQ(4950, _(parts).map([](const fn::Records<int>& part) {
+                     return _(part).sum();
+                   }).sum(),
+            "Parts should have all the records once.");
+
+  auto thrown = false;
+  try {
+    fn::records<int>(path, 2);
+  } catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+
+  EXPECT_TRUE(thrown, "Misaligned records should throw.");
+  remove(path.c_str());
+}
+
+TEST(Csv, Scan) {
+  // Quoted delimiters and newlines, CRLF, and rows longer than a block.
+  std::string text = "id,name,qty\r\n1,\"a,b\",3\n2,\"x\ny\",-4\n";
+  for (int i = 3; i < 100; i++) {
+    text += std::to_string(i) + ",\"" + std::string(70, ',') + "\",1\n";
+  }
+
+  auto rows = fn::csv(text).skip(1);
+  size_t counted = 0;
+  std::thread counter([&]() { counted = rows.size(); });
+  EXPECT_EQ(size_t(99), rows.size(), "");
+  counter.join();
+  EXPECT_EQ(size_t(99), counted, "Rows may be counted from any thread.");
+
+  auto row = rows.begin();
+  EXPECT_EQ(size_t(3), row->size(), "");
+  EXPECT_EQ(std::string("a,b"), (*row)[1].str(), "");
+  EXPECT_EQ(std::string(), (*row)[5].str(), "Missing fields are empty.");
+
+  auto first = row++;
+  EXPECT_EQ(std::string("1,\"a,b\",3"), first->line().str(), "");
+  EXPECT_EQ(std::string("x\ny"), (*row)[1].str(), "");
+  EXPECT_EQ(-4, row->get<int>(2), "");
+
+  const std::string extremes = "-9223372036854775808,9223372036854775807\n";
+  auto limits = fn::csv(extremes).begin();
+  EXPECT_TRUE(limits->get<int64_t>(0) == std::numeric_limits<int64_t>::min(),
+              "The lowest value should parse without overflowing.");
+  EXPECT_TRUE(limits->get<int64_t>(1) == std::numeric_limits<int64_t>::max(),
+              "");
+
+  EXPECT_EQ(96, _(rows).map(fn::col<int>(2)).sum(), "");
+  EXPECT_EQ(4950L, _(rows).map(fn::col<long>(0)).sum(), "");
+  EXPECT_EQ(std::string("qty"), fn::csv(text).begin()->get<std::string>(2),
+            "The CR should be stripped.");
+
+  const auto path = temp_file("1.5\tx\n2.5\ty");
+  EXPECT_EQ(4.0, _(fn::mmap_csv(path, '\t')).map(fn::col<double>(0)).sum(),
+            "");
+  remove(path.c_str());
+}
+
+TEST(Stream, Lines) {
+  std::string text;
+  for (int i = 0; i < 1000; i++) {
+    text += std::string(i % 20, 'x') + std::to_string(i) + "\n";
+  }
+
+  int fds[2];
+  EXPECT_EQ(0, pipe(fds), "");
+  std::thread writer([&]() {
+    // Lines longer than a block, and a last line without '\n'.
+    const auto all = text + std::string(100, 'y');
+    EXPECT_TRUE(write(fds[1], all.data(), all.size()) > 0, "");
+    close(fds[1]);
+  });
+
+  auto lines = fn::read_lines(fds[0], 8);
+  EXPECT_TRUE(_(lines).explain().find("rows unknown") != std::string::npos,
+              "The size of a stream is not known.");
+
+  size_t count = 0;
+  size_t bytes = 0;
+  for (const auto& line : lines) {
+    count++;
+    bytes += line.size() + 1;
+  }
+
+  writer.join();
+  close(fds[0]);
+  EXPECT_EQ(size_t(1001), count, "");
+  EXPECT_EQ(text.size() + 101, bytes, "");
+  EXPECT_TRUE(lines.begin() == lines.end(), "Lines are only read once.");
+}
+
+TEST(Files, Read) {
+  vector<std::string> paths;
+  for (int i = 0; i < 20; i++) {
+    paths.push_back(temp_file(std::string(i * 100, 'x') + "\n"));
+  }
+
+  for (auto order : {fn::FileOrder::PATHS, fn::FileOrder::COMPLETION}) {
+    size_t index = 0;
+    size_t bytes = 0;
+    auto ordered = true;
+    for (const auto& file : fn::files(paths, order, 4)) {
+      ordered &= file.index == index++;
+      bytes += file.data.size();
+      EXPECT_EQ(paths[file.index], file.path.str(), "");
+    }
+
+    EXPECT_EQ(size_t(20), index, "");
+    EXPECT_EQ(size_t(19020), bytes, "");
+    if (order == fn::FileOrder::PATHS) {
+      EXPECT_TRUE(ordered, "Files should be read in the order of the paths.");
+    }
+  }
+
+  size_t files = 0;
+  for (const auto& part : fn::files(paths).split(3)) {
+    files += _(part).size();
+  }
+
+  EXPECT_EQ(size_t(20), files, "Parts should have all the files once.");
+
+  for (const auto& path : paths) {
+    remove(path.c_str());
+  }
+
+  auto thrown = false;
+  try {
+    _(fn::files(paths)).size();
+  } catch (const std::system_error&) {
+    thrown = true;
+  }
+
+  EXPECT_TRUE(thrown, "Missing files should throw.");
+}
+
+TEST(Split, Tokens) {
+  vector<std::string> text{"the quick  brown", "", " fox, the dog.",
+                           std::string(70, 'a') + " the\t" +
+                               std::string(60, 'b')};
+  auto words = _(&text).split(" \t,.");
+
+  size_t total = 0;
+  {
+    Allocations allocations;
+    words.for_each([&total](fn::StringView w) { total += w.size(); });
+    EXPECT_EQ(size_t(0), allocations.count(), "Tokens are not allocated.");
+  }
+
+  EXPECT_EQ(size_t(155), total, "");
+  EXPECT_TRUE(words.as_vector() ==
+                  vector<fn::StringView>(words.begin(), words.end()),
+              "Iterating should split strings like evaluating.");
+
+  auto counts = words.count_by();
+  EXPECT_EQ(size_t(3), counts[fn::StringView("the")], "");
+  EXPECT_EQ(size_t(1), counts[fn::StringView("dog")], "");
+
+  auto lengths = words.count_by([](fn::StringView w) { return w.size(); });
+  EXPECT_EQ(size_t(5), lengths[3], "");
+
+  // Large delimiter sets are classified without SIMD.
+  auto letters = _({std::string("a1b22c333d")}).split("0123456789");
+  EXPECT_EQ(std::string("abcd"),
+            letters.fold_left(std::string(),
+                              [](const std::string& s, fn::StringView w) {
+                                return s + w.str();
+                              }),
+            "");
+}
+
+TEST(Filter, ContainsAny) {
+  vector<std::string> lines{"ushers", "xhis", "sh", "ahex", "",
+                            std::string(100, 'z') + "hers"};
+  auto matches = _(&lines).filter_contains_any({"he", "she", "his", "hers"});
+  EXPECT_EQ(size_t(4), matches.size(), "");
+  EXPECT_TRUE(matches.as_vector() ==
+                  vector<std::string>(matches.begin(), matches.end()),
+              "Iterating should filter like evaluating.");
+
+  // Patterns starting with many distinct bytes are not looked for with SIMD.
+  vector<std::string> patterns;
+  for (char c = 'a'; c <= 'z'; c++) {
+    patterns.push_back(std::string(1, c) + "!");
+  }
+
+  auto contains = fn::contains_any(patterns);
+  EXPECT_TRUE(contains("xyz q!"), "");
+  EXPECT_FALSE(contains("xyz q"), "");
+  EXPECT_FALSE(contains("!q"), "");
+  EXPECT_TRUE(fn::contains_any({"x"})("abcx"), "A match on the last byte.");
+  EXPECT_TRUE(fn::contains_any({""})("abc"), "Empty patterns match.");
+  EXPECT_FALSE(fn::contains_any({})("abc"), "");
+}
+
+TEST(Sink, Binary) {
+  // More than all the buffers of a sink, and not a multiple of a block.
+  const int n = 1500000;
+  const auto path = temp_file("");
+  _(range(0, n)).to_file(path);
+  auto ints = fn::records<int>(path);
+  EXPECT_EQ(size_t(n), ints.size(), "");
+  EXPECT_EQ(n - 1, ints[n - 1], "");
+  EXPECT_EQ((long long)n * (n - 1) / 2,
+            _(ints).map([](int i) { return (long long)i; }).sum(), "");
+
+  // Filesystems may not support O_DIRECT, which fails when opening.
+  try {
+    _(range(0, n)).to_file(path, fn::WriteMode::DIRECT);
+    EXPECT_EQ(n - 1, fn::records<int>(path)[n - 1], "");
+  } catch (const std::system_error&) {
+  }
+
+  const int fd = open(path.c_str(), O_WRONLY | O_TRUNC);
+  auto sink = fn::binary_sink(fd);
+  vector<double> doubles{1.5, 2.5};
+  _(&doubles) >> sink;
+  sink.close();
+  auto thrown = false;
+  try {
+    _(&doubles) >> sink;
+  } catch (const std::logic_error&) {
+    thrown = true;
+  }
+
+  EXPECT_TRUE(thrown, "Closed sinks should throw.");
+  EXPECT_EQ(0, close(fd), "The sink should not close its descriptor.");
+  EXPECT_EQ(2.5, fn::records<double>(path)[1], "");
+  remove(path.c_str());
+}
+
+TEST(Sink, Text) {
+  const auto path = temp_file("");
+  FILE* f = fopen(path.c_str(), "w");
+  fprintf(f, "header\n");
+  auto sink = fn::text_sink(f);
+  vector<int> ints{0, -7, 42, 1234567, std::numeric_limits<int>::min()};
+  vector<std::string> names{"a", "b", "c", "d", "e"};
+  _(&ints) >> sink;
+  _(&ints).zip(_(&names)) >> sink;
+  sink(std::make_pair(std::make_pair('x', 0.5), fn::StringView("y")));
+  sink(std::numeric_limits<uint64_t>::max());
+  sink(0.1);
+  sink(-1e300);
+  sink.close();
+  fclose(f);
+
+  std::string expected =
+      "header\n0\n-7\n42\n1234567\n-2147483648\n0\ta\n-7\tb\n42\tc\n"
+      "1234567\td\n-2147483648\te\nx\t0.5\ty\n18446744073709551615\n"
+      "0.1\n-1e+300\n";
+  std::string text;
+  for (auto line : fn::mmap_lines(path)) {
+    text += line.str() + "\n";
+  }
+
+  EXPECT_EQ(expected, text, "");
+
+  // Big enough to fill all the buffers of the sink.
+  const int fd = open(path.c_str(), O_WRONLY | O_TRUNC);
+  auto numbers = fn::text_sink(fd, ",", ";");
+  _(range(0, 1000000)) >> numbers;
+  numbers.close();
+  close(fd);
+  text = fn::mmap_lines(path).begin()->str();
+  EXPECT_EQ(size_t(6888890), text.size(), "");
+  EXPECT_EQ(std::string("999998;999999;"), text.substr(text.size() - 14), "");
+  remove(path.c_str());
+}
+
+TEST(Packed, Blocks) {
+  // Sorted timestamps, some blocks of random values (a small and a large
+  // range), and a partial block of negative values.
+  vector<int64_t> values;
+  for (int64_t i = 0; i < 1000; i++) {
+    values.push_back(1600000000000 + i * 1000 + i % 7);
+  }
+
+  for (int64_t i = 0; i < 256; i++) {
+    values.push_back((i * 7919) % 1000);
+  }
+
+  for (int64_t i = 0; i < 128; i++) {
+    values.push_back(i % 2 ? std::numeric_limits<int64_t>::max()
+                           : std::numeric_limits<int64_t>::min());
+  }
+
+  for (int64_t i = 0; i < 50; i++) {
+    values.push_back(-i * i);
+  }
+
+  auto column = fn::packed(values);
+  EXPECT_EQ(values.size(), column.size(), "");
+  EXPECT_TRUE(vector<int64_t>(column.begin(), column.end()) == values, "");
+  EXPECT_TRUE(column.bytes() < 4 * values.size(), "");
+  EXPECT_EQ(size_t(64), _(column).filter([](int64_t v) {
+    return v == std::numeric_limits<int64_t>::max();
+  }).size(), "");
+
+  auto range = fn::between<int64_t>(1600000100000, 1600000199999);
+  EXPECT_TRUE(_(column).filter(range).explain().find("skipping blocks") !=
+                  std::string::npos,
+              "");
+  EXPECT_TRUE(_(&values).filter(range).as_vector() ==
+                  _(column).filter(range).as_vector(),
+              "");
+  EXPECT_EQ(size_t(5), _(column).filter(fn::between<int64_t>(-5, 3)).size(),
+            "");
+
+  const auto path = temp_file("");
+  auto sink = fn::packed_sink<int64_t>(path);
+  _(&values) >> sink;
+  sink.close();
+  auto mapped = fn::mmap_packed<int64_t>(path);
+  EXPECT_TRUE(vector<int64_t>(mapped.begin(), mapped.end()) == values, "");
+
+  auto thrown = false;
+  try {
+    fn::mmap_packed<int32_t>(path);
+  } catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+
+  EXPECT_TRUE(thrown, "The type of the values should be checked.");
+  remove(path.c_str());
+}
+
+TEST(External, SortAndReduce) {
+  vector<int> ints;
+  for (int i = 0; i < 100000; i++) {
+    ints.push_back((i * 7919) % 100003);
+  }
+
+  fn::test::Allocations allocations;
+  auto sorted = _(&ints).external_sort(64 << 10);
+  EXPECT_TRUE(allocations.count() < 24,
+              "The run should be allocated once, not grown for each of the "
+              "7 runs.");
+  auto expected = ints;
+  std::sort(expected.begin(), expected.end());
+  EXPECT_TRUE(sorted.as_vector() == expected, "");
+
+  auto descending = _(&ints).external_sort(1 << 20, std::greater<int>());
+  EXPECT_EQ(100002, *descending.begin(), "");
+
+  auto pairs = _(&ints).map([](int i) { return std::make_pair(i % 5000, 1L); });
+  auto counts = pairs.external_reduce_by(16 << 10, std::plus<long>());
+  auto in_memory = pairs.external_reduce_by(1 << 20, std::plus<long>());
+
+  // With room for 21 groups, the 78 keys or so of each partition are spilled
+  // again by partitions of another hash.
+  auto repartitioned = pairs.external_reduce_by(1 << 10, std::plus<long>());
+  EXPECT_TRUE(repartitioned.as_vector() == repartitioned.as_vector(), "");
+  for (const auto& groups : {counts.as_vector(), in_memory.as_vector(),
+                             repartitioned.as_vector()}) {
+    EXPECT_EQ(size_t(5000), groups.size(), "");
+    EXPECT_EQ(size_t(100000), _(&groups).map([](std::pair<int, long> g) {
+      return g.second;
+    }).sum(), "");
+    EXPECT_EQ(size_t(5000), _(&groups).map([](std::pair<int, long> g) {
+      return g.first;
+    }).as_set().size(), "Each key should be reduced once.");
+  }
+
+  // Spilling fails where temporary files cannot be created.
+  const char* tmpdir = getenv("TMPDIR");
+  const std::string saved = tmpdir ? tmpdir : "";
+  setenv("TMPDIR", "/nonexistent", 1);
+  auto thrown = false;
+  try {
+    _(&ints).external_sort(64 << 10);
+  } catch (const std::system_error&) {
+    thrown = true;
+  }
+
+  EXPECT_TRUE(thrown, "");
+  EXPECT_EQ(ints.size(), _(&ints).external_sort(1 << 20).size(),
+            "Values fitting in memory should not be spilled.");
+  if (tmpdir) {
+    setenv("TMPDIR", saved.c_str(), 1);
+  } else {
+    unsetenv("TMPDIR");
+  }
+}
+
+TEST(Async, Pipeline) {
+  vector<int> ints;
+  for (int i = 0; i < 100000; i++) {
+    ints.push_back(i);
+  }
+
+  auto squares = _(&ints).map([](int i) { return (long)i * i; }).async();
+  auto odd = squares.filter([](long i) { return i % 2 == 1; });
+  EXPECT_EQ(_(&ints).map([](int i) { return (long)i * i; }).sum(),
+            squares.sum(), "");
+  EXPECT_EQ(size_t(50000), odd.size(), "Views can be evaluated again.");
+
+  size_t iterated = 0;
+  for (long i : squares) {
+    EXPECT_EQ((long)iterated * (long)iterated, i, "");
+    if (++iterated == 3000) {
+      break;
+    }
+  }
+
+  EXPECT_EQ(size_t(3000), iterated, "Iterating can stop early.");
+
+  auto failing = _(&ints).map([](int i) {
+    if (i == 50000) {
+      throw std::runtime_error("bad input");
+    }
+
+    return i;
+  });
+
+  size_t seen = 0;
+  auto thrown = false;
+  try {
+    failing.async() >> [&seen](int) { seen++; };
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+
+  EXPECT_TRUE(thrown, "Exceptions should cross the boundary.");
+  EXPECT_EQ(size_t(50000), seen, "Elements before the exception are kept.");
+
+  thrown = false;
+  try {
+    squares >> [](long i) {
+      if (i > 1000) {
+        throw std::runtime_error("stop");
+      }
+    };
+  } catch (const std::runtime_error&) {
+    thrown = true;
+  }
+
+  EXPECT_TRUE(thrown, "The producer should stop with the consumer.");
+}
+
 int main() {
   fn::test::run_all_tests();
 }